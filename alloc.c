@@ -4,7 +4,9 @@
 
 #include <error.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void
 memory_exhausted (int errnum)
@@ -41,3 +43,96 @@ checked_grow_alloc (void *ptr, size_t *size)
   *size = *size < max / 2 ? 2 * *size : max;
   return checked_realloc (ptr, *size);
 }
+
+struct arena_chunk
+{
+  struct arena_chunk *prev;
+  size_t size;
+  max_align_t data[];
+};
+
+// Chunks grow geometrically up to this size
+#define ARENA_CHUNK_MAX ((size_t) 1 << 20)
+
+void
+arena_init (struct arena *a, size_t chunk_size)
+{
+  a->chunk = NULL;
+  a->next = a->end = NULL;
+  a->chunk_size = chunk_size ? chunk_size : 1;
+}
+
+// Start a new chunk with room for at least SIZE bytes
+static void
+arena_grow (struct arena *a, size_t size)
+{
+  size_t n = a->chunk_size < size ? size : a->chunk_size;
+  struct arena_chunk *c =
+    checked_malloc (offsetof (struct arena_chunk, data) + n);
+  c->prev = a->chunk;
+  c->size = n;
+  a->chunk = c;
+  a->next = (char *) c->data;
+  a->end = a->next + n;
+  if (a->chunk_size < ARENA_CHUNK_MAX)
+    a->chunk_size *= 2;
+}
+
+void *
+arena_alloc (struct arena *a, size_t size)
+{
+  size_t align = _Alignof (max_align_t);
+  size_t pad = -(uintptr_t) a->next & (align - 1);
+  if (! a->chunk || (size_t) (a->end - a->next) < pad + size)
+    {
+      arena_grow (a, size);
+      pad = 0;
+    }
+  void *p = a->next + pad;
+  a->next += pad + size;
+  return p;
+}
+
+// Copy the N bytes at S into A as a null-terminated string
+char *
+arena_strndup (struct arena *a, char const *s, size_t n)
+{
+  if (! a->chunk || (size_t) (a->end - a->next) < n + 1)
+    arena_grow (a, n + 1);
+  char *p = a->next;
+  a->next += n + 1;
+  memcpy (p, s, n);
+  p[n] = 0;
+  return p;
+}
+
+// Release everything in A, keeping only its newest chunk for reuse
+void
+arena_reset (struct arena *a)
+{
+  if (! a->chunk)
+    return;
+  struct arena_chunk *c = a->chunk->prev;
+  while (c)
+    {
+      struct arena_chunk *prev = c->prev;
+      free (c);
+      c = prev;
+    }
+  a->chunk->prev = NULL;
+  a->next = (char *) a->chunk->data;
+}
+
+void
+arena_free (struct arena *a)
+{
+  struct arena_chunk *c = a->chunk;
+  while (c)
+    {
+      struct arena_chunk *prev = c->prev;
+      free (c);
+      c = prev;
+    }
+  a->chunk = NULL;
+  a->next = a->end = NULL;
+}
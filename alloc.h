@@ -3,3 +3,19 @@
 void *checked_malloc (size_t);
 void *checked_realloc (void *, size_t);
 void *checked_grow_alloc (void *, size_t *);
+
+// Bump allocator: objects are carved out of large chunks and are all
+// released together by arena_reset or arena_free.
+struct arena_chunk;
+struct arena
+{
+  struct arena_chunk *chunk; // newest chunk, linked to older ones
+  char *next;                // free space in the newest chunk
+  char *end;
+  size_t chunk_size;         // minimum size of the next chunk
+};
+void arena_init (struct arena *, size_t);
+void *arena_alloc (struct arena *, size_t);
+char *arena_strndup (struct arena *, char const *, size_t);
+void arena_reset (struct arena *);
+void arena_free (struct arena *);
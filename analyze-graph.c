@@ -0,0 +1,386 @@
+// UCLA CS 111 Lab 1 analysis of time-travel graphs without running them
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "command.h"
+#include "command-internals.h"
+#include "alloc.h"
+#include "time-travel.h"
+
+// Graphs up to this many nodes get their maximum antichain exactly; larger
+// ones get the widest level, a lower bound
+#define ANTICHAIN_MAX 4096
+
+// Bytes of reachability bits kept at once for the transitive reduction
+#define REACH_BUDGET (32 << 20)
+
+// The graph being analyzed, with its nodes by seq_no - 1
+typedef struct analysis {
+    graph_node **nodes;
+    size_t count;
+    size_t *first_edge; // index of each node's first edge in the flat edge arrays
+    size_t edge_count;
+    char *redundant; // by edge: implied by another path
+    double *cost; // by node
+    uint64_t *reach; // by node, words of the nodes it reaches, if all fit
+    size_t words;
+} analysis;
+
+static size_t reduce_edges (analysis *a);
+static size_t max_antichain (analysis *a);
+static size_t widest_level (analysis *a);
+static double simulate (analysis *a, int cores);
+static void write_dot (analysis *a, FILE *dot, char *critical, size_t *via);
+static int named (char **seen, size_t count, char const *name);
+static void write_label (FILE *dot, char const *text);
+
+// Prints the shape of the graph of node_list without running it: its nodes
+// and edges, the edges left after transitive reduction, the critical path,
+// the maximum antichain width, and the makespan time travel would take on
+// 1 to max_cores cores.  Nodes cost a unit each, or with a profile their
+// last wall time (unknown ones the mean of the known ones), and ready nodes
+// start in the order execute_parallel starts them.  If dot is not NULL, the
+// graph is written to it in Graphviz's DOT format.
+void analyze_graph (graph_nodes *node_list, profile *prof, int max_cores, FILE *dot) {
+    analysis a;
+    memset (&a, 0, sizeof a);
+    graph_nodes *n;
+    for (n = node_list; n && n->node; n = n->next)
+        a.count++;
+    a.nodes = (graph_node **) checked_malloc ((a.count + 1) * sizeof (graph_node *));
+    a.first_edge = (size_t *) checked_malloc ((a.count + 1) * sizeof (size_t));
+    a.cost = (double *) checked_malloc ((a.count + 1) * sizeof (double));
+    size_t i, k;
+    for (n = node_list, i = 0; n && n->node; n = n->next, i++) {
+        a.nodes[i] = n->node;
+        a.first_edge[i] = a.edge_count;
+        a.edge_count += n->node->edge_count;
+    }
+    a.first_edge[a.count] = a.edge_count;
+
+    double guess = 1, total = 0;
+    size_t known = 0;
+    for (i = 0; prof && i < a.count; i++)
+        if (prof->seconds[a.nodes[i]->profile_id] >= 0) {
+            total += prof->seconds[a.nodes[i]->profile_id];
+            known++;
+        }
+    if (prof)
+        guess = known ? total / known : 1e-3;
+    double sequential = 0;
+    for (i = 0; i < a.count; i++) {
+        a.cost[i] = prof && prof->seconds[a.nodes[i]->profile_id] >= 0 ? prof->seconds[a.nodes[i]->profile_id] : guess;
+        sequential += a.cost[i];
+    }
+
+    // The longest path by cost, from each node's latest-finishing
+    // prerequisite; nodes come in script order, so a node's prerequisites
+    // are done before it
+    double *start = (double *) checked_malloc ((a.count + 1) * sizeof (double));
+    size_t *via = (size_t *) checked_malloc ((a.count + 1) * sizeof (size_t));
+    size_t last = 0;
+    double critical_length = 0;
+    for (i = 0; i < a.count; i++) {
+        start[i] = 0;
+        via[i] = (size_t) -1;
+    }
+    for (i = 0; i < a.count; i++) {
+        double end = start[i] + a.cost[i];
+        if (end > critical_length) {
+            critical_length = end;
+            last = i;
+        }
+        for (k = 0; k < (size_t) a.nodes[i]->edge_count; k++) {
+            size_t w = a.nodes[i]->out_edges[k]->seq_no - 1;
+            if (end > start[w]) {
+                start[w] = end;
+                via[w] = i;
+            }
+        }
+    }
+    char *critical = (char *) checked_malloc (a.count + 1);
+    memset (critical, 0, a.count + 1);
+    size_t critical_count = 0;
+    for (i = last; a.count && i != (size_t) -1; i = via[i]) {
+        critical[i] = 1;
+        critical_count++;
+    }
+
+    size_t reduced = reduce_edges (&a);
+    size_t width = a.reach && a.count <= ANTICHAIN_MAX ? max_antichain (&a) : widest_level (&a);
+
+    printf ("nodes: %zu\n", a.count);
+    printf ("edges: %zu\n", a.edge_count);
+    printf ("edges after transitive reduction: %zu\n", reduced);
+    printf ("critical path: %g (%zu nodes)\n", critical_length, critical_count);
+    if (a.reach && a.count <= ANTICHAIN_MAX)
+        printf ("maximum antichain width: %zu\n", width);
+    else
+        printf ("maximum antichain width: at least %zu (the widest level)\n", width);
+    printf ("sequential time: %g\n", sequential);
+    printf ("cores\tmakespan\tspeedup\n");
+    int cores;
+    for (cores = 1; cores <= max_cores; cores++) {
+        double makespan = simulate (&a, cores);
+        printf ("%d\t%g\t%.2f\n", cores, makespan, makespan > 0 ? sequential / makespan : 1.0);
+    }
+    printf ("critical path commands:\n");
+    for (i = 0; i < a.count; i++)
+        if (critical[i]) {
+            char *text = command_text (a.nodes[i]->command);
+            printf ("%d\t%g\t%s\n", a.nodes[i]->seq_no, a.cost[i], text);
+            free (text);
+        }
+
+    if (dot)
+        write_dot (&a, dot, critical, via);
+
+    free (critical);
+    free (start);
+    free (via);
+    free (a.reach);
+    free (a.redundant);
+    free (a.cost);
+    free (a.first_edge);
+    free (a.nodes);
+}
+
+// Marks the edges that another path implies, and returns how many are not.
+// Reachability is computed a block of target nodes at a time, within
+// REACH_BUDGET; if one block covers the graph, its bits are kept in
+// a->reach.  Each node's out edges are in script order of their
+// destinations, as add_dependencies adds them, so an edge is implied when
+// its destination is reachable through an earlier one.
+static size_t reduce_edges (analysis *a) {
+    size_t n = a->count;
+    size_t all = (n + 63) / 64;
+    size_t words = n ? REACH_BUDGET / 8 / n : 1;
+    if (words > all)
+        words = all;
+    if (words < 1)
+        words = 1;
+    if (n <= ANTICHAIN_MAX)
+        words = all ? all : 1;
+    size_t bits = 64 * words;
+    uint64_t *reach = (uint64_t *) checked_malloc ((n + 1) * words * sizeof (uint64_t));
+    a->redundant = (char *) checked_malloc (a->edge_count + 1);
+    memset (a->redundant, 0, a->edge_count + 1);
+
+    size_t lo, u, k, j;
+    for (lo = 0; lo < n; lo += bits) {
+        memset (reach, 0, n * words * sizeof (uint64_t));
+        // Nodes after the block reach none of it
+        for (u = (lo + bits < n ? lo + bits : n); u-- > 0; ) {
+            uint64_t *r = reach + u * words;
+            graph_node *node = a->nodes[u];
+            for (k = 0; k < (size_t) node->edge_count; k++) {
+                size_t w = node->out_edges[k]->seq_no - 1;
+                int in_block = w >= lo && w < lo + bits;
+                if (in_block && (r[(w - lo) / 64] >> ((w - lo) % 64) & 1))
+                    a->redundant[a->first_edge[u] + k] = 1;
+                if (w >= lo + bits)
+                    continue;
+                uint64_t *rw = reach + w * words;
+                for (j = 0; j < words; j++)
+                    r[j] |= rw[j];
+                if (in_block)
+                    r[(w - lo) / 64] |= (uint64_t) 1 << ((w - lo) % 64);
+            }
+        }
+    }
+
+    if (bits >= n) {
+        a->reach = reach;
+        a->words = words;
+    } else
+        free (reach);
+    size_t kept = 0;
+    for (k = 0; k < a->edge_count; k++)
+        kept += !a->redundant[k];
+    return kept;
+}
+
+// Tries to match left node u to a node it reaches, moving earlier matches
+static int augment (analysis *a, size_t u, uint64_t *seen, size_t *match) {
+    uint64_t *r = a->reach + u * a->words;
+    size_t j;
+    for (j = 0; j < a->words; j++) {
+        uint64_t free_bits;
+        while ((free_bits = r[j] & ~seen[j])) {
+            int b = __builtin_ctzll (free_bits);
+            size_t v = 64 * j + b;
+            seen[j] |= (uint64_t) 1 << b;
+            if (match[v] == (size_t) -1 || augment (a, match[v], seen, match)) {
+                match[v] = u;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Returns the size of the largest set of nodes none of which reaches
+// another, which by Dilworth's theorem is the number of nodes less a
+// maximum matching between each node and the nodes it reaches
+static size_t max_antichain (analysis *a) {
+    size_t n = a->count, u, matched = 0;
+    size_t *match = (size_t *) checked_malloc ((n + 1) * sizeof (size_t));
+    uint64_t *seen = (uint64_t *) checked_malloc ((a->words + 1) * sizeof (uint64_t));
+    for (u = 0; u < n; u++)
+        match[u] = (size_t) -1;
+    for (u = 0; u < n; u++) {
+        memset (seen, 0, a->words * sizeof (uint64_t));
+        matched += augment (a, u, seen, match);
+    }
+    free (seen);
+    free (match);
+    return n - matched;
+}
+
+// Returns the most nodes at the same depth, where depth is the most edges
+// on a path to a node; no node reaches another of the same depth
+static size_t widest_level (analysis *a) {
+    size_t n = a->count, i, k, widest = 0;
+    size_t *depth = (size_t *) checked_malloc ((n + 1) * sizeof (size_t));
+    size_t *width = (size_t *) checked_malloc ((n + 1) * sizeof (size_t));
+    for (i = 0; i < n; i++)
+        depth[i] = width[i] = 0;
+    for (i = 0; i < n; i++) {
+        if (++width[depth[i]] > widest)
+            widest = width[depth[i]];
+        for (k = 0; k < (size_t) a->nodes[i]->edge_count; k++) {
+            size_t w = a->nodes[i]->out_edges[k]->seq_no - 1;
+            if (depth[w] < depth[i] + 1)
+                depth[w] = depth[i] + 1;
+        }
+    }
+    free (depth);
+    free (width);
+    return widest;
+}
+
+// Returns when the last node would finish on the given number of cores,
+// starting ready nodes in execute_parallel's order whenever a core is free
+static double simulate (analysis *a, int cores) {
+    size_t n = a->count, i, k, done = 0;
+    int *left = (int *) checked_malloc ((n + 1) * sizeof (int));
+    double *finish = (double *) checked_malloc (cores * sizeof (double));
+    graph_node **running = (graph_node **) checked_malloc (cores * sizeof (graph_node *));
+    ready_queue ready = { NULL, 0, 0 };
+    int busy = 0, c;
+    double now = 0;
+
+    for (i = 0; i < n; i++)
+        left[i] = 0;
+    for (i = 0; i < n; i++)
+        for (k = 0; k < (size_t) a->nodes[i]->edge_count; k++)
+            left[a->nodes[i]->out_edges[k]->seq_no - 1]++;
+    for (i = 0; i < n; i++)
+        if (!left[i])
+            push_ready (&ready, a->nodes[i]);
+
+    while (done < n) {
+        while (busy < cores && ready.count) {
+            graph_node *node = pop_ready (&ready);
+            running[busy] = node;
+            finish[busy++] = now + a->cost[node->seq_no - 1];
+        }
+        int first = 0;
+        for (c = 1; c < busy; c++)
+            if (finish[c] < finish[first])
+                first = c;
+        graph_node *node = running[first];
+        now = finish[first];
+        running[first] = running[--busy];
+        finish[first] = finish[busy];
+        done++;
+        for (k = 0; k < (size_t) node->edge_count; k++)
+            if (--left[node->out_edges[k]->seq_no - 1] == 0)
+                push_ready (&ready, node->out_edges[k]);
+    }
+
+    free (ready.nodes);
+    free (running);
+    free (finish);
+    free (left);
+    return now;
+}
+
+// Writes the graph in DOT: each node named by its seq_no and labeled with
+// its command, each edge labeled with the files that order its ends.  The
+// critical path is red, and edges another path implies are dotted.
+static void write_dot (analysis *a, FILE *dot, char *critical, size_t *via) {
+    size_t i, k;
+    char **v, **w;
+    fprintf (dot, "digraph timetrash {\n");
+    fprintf (dot, "  node [shape=box];\n");
+    for (i = 0; i < a->count; i++) {
+        char *text = command_text (a->nodes[i]->command);
+        fprintf (dot, "  n%d [label=", a->nodes[i]->seq_no);
+        write_label (dot, text);
+        fprintf (dot, "%s];\n", critical[i] ? ", color=red" : "");
+        free (text);
+    }
+    for (i = 0; i < a->count; i++) {
+        graph_node *src = a->nodes[i];
+        for (k = 0; k < (size_t) src->edge_count; k++) {
+            graph_node *dst = src->out_edges[k];
+            size_t len = 0, size = 64, count = 0;
+            char *files = checked_malloc (size);
+            char *seen[16]; // the first files named, to name each once
+            files[0] = 0;
+
+            // A file joins them if either writes it and the other uses it
+            char **lists[4][2] = {
+                { src->outputs, dst->inputs }, { src->inputs, dst->outputs },
+                { src->outputs, dst->outputs }, { NULL, NULL }
+            };
+            int l;
+            for (l = 0; lists[l][0]; l++)
+                for (v = lists[l][0]; *v; v++)
+                    for (w = lists[l][1]; *w; w++)
+                        if (!strcmp (*v, *w) && !named (seen, count, *v)) {
+                            if (count < sizeof seen / sizeof *seen)
+                                seen[count++] = *v;
+                            size_t need = len + strlen (*v) + 3;
+                            while (need > size)
+                                files = checked_grow_alloc (files, &size);
+                            len += sprintf (files + len, "%s%s", len ? ", " : "", *v);
+                        }
+
+            fprintf (dot, "  n%d -> n%d [label=", src->seq_no, dst->seq_no);
+            write_label (dot, files);
+            if (critical[dst->seq_no - 1] && via[dst->seq_no - 1] == i)
+                fprintf (dot, ", color=red");
+            if (a->redundant[a->first_edge[i] + k])
+                fprintf (dot, ", style=dotted");
+            fprintf (dot, "];\n");
+            free (files);
+        }
+    }
+    fprintf (dot, "}\n");
+}
+
+// Returns 1 if name is one of the count names at seen
+static int named (char **seen, size_t count, char const *name) {
+    size_t i;
+    for (i = 0; i < count; i++)
+        if (!strcmp (seen[i], name))
+            return 1;
+    return 0;
+}
+
+// Writes text to dot as a quoted string
+static void write_label (FILE *dot, char const *text) {
+    putc ('"', dot);
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\')
+            putc ('\\', dot);
+        putc (*text, dot);
+    }
+    putc ('"', dot);
+}
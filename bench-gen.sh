@@ -0,0 +1,51 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Generate a synthetic script for benchmarks.
+#
+# Command I writes file fI.  With probability DENSITY percent it reads an
+# earlier command's file, and otherwise it echoes a word of WORD-LENGTH
+# letters.  Its output goes through a pipeline of DEPTH stages in all, and
+# the whole is nested NESTING subshells deep.
+
+usage () {
+  echo >&2 "usage: $0 [-n COMMANDS] [-d DENSITY] [-p DEPTH] [-s NESTING] [-w WORD-LENGTH] [-r SEED]"
+  exit 1
+}
+
+n=1000 density=20 depth=1 nesting=0 wordlen=8 seed=1
+while getopts n:d:p:s:w:r: opt; do
+  case $opt in
+    n) n=$OPTARG;;
+    d) density=$OPTARG;;
+    p) depth=$OPTARG;;
+    s) nesting=$OPTARG;;
+    w) wordlen=$OPTARG;;
+    r) seed=$OPTARG;;
+    *) usage;;
+  esac
+done
+test $OPTIND -gt $# || usage
+
+exec awk -v n=$n -v density=$density -v depth=$depth -v nesting=$nesting \
+         -v wordlen=$wordlen -v seed=$seed '
+BEGIN {
+  srand(seed)
+  letters = "abcdefghijklmnopqrstuvwxyz"
+  for (i = 0; i < n; i++) {
+    if (i && rand() * 100 < density)
+      cmd = "cat f" int(rand() * i)
+    else {
+      word = ""
+      for (j = 0; j < wordlen; j++)
+        word = word substr(letters, 1 + int(rand() * 26), 1)
+      cmd = "echo " word
+    }
+    for (j = 1; j < depth; j++)
+      cmd = cmd " | cat"
+    cmd = cmd " > f" i
+    for (j = 0; j < nesting; j++)
+      cmd = "(" cmd "; true)"
+    print cmd
+    print ""
+  }
+}'
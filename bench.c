@@ -0,0 +1,263 @@
+// UCLA CS 111 Lab 1 benchmark harness
+
+/* Times the phases of timetrash separately: tokenizing, parsing,
+   building the time-travel graph, and scheduling its nodes, and
+   optionally whole runs against /bin/sh.  Results are printed one per
+   line as LABEL<tab>METRIC<tab>VALUE<tab>UNIT.  */
+
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "command.h"
+#include "command-internals.h"
+#include "alloc.h"
+#include "time-travel.h"
+
+struct token_stream;
+struct token_stream *read_token_stream (command_stream_t);
+
+static char const *program_name;
+static char const *label = "-";
+
+static double
+seconds_now (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void
+report (char const *metric, double value, char const *unit)
+{
+  printf ("%s\t%s\t%.10g\t%s\n", label, metric, value, unit);
+}
+
+// Return a fresh copy of the LEN bytes at SCRIPT, which parsing modifies
+static char *
+copy_script (char const *script, size_t len)
+{
+  char *copy = checked_malloc (len + 1);
+  memcpy (copy, script, len);
+  return copy;
+}
+
+// Return the time taken to tokenize every command of SCRIPT
+static double
+time_tokenize (char const *script, size_t len)
+{
+  char *copy = copy_script (script, len);
+  command_stream_t s = make_command_stream_from_buffer (copy, len);
+  double start = seconds_now ();
+  while (read_token_stream (s))
+    continue;
+  double elapsed = seconds_now () - start;
+  free_command_stream (s);
+  free (copy);
+  return elapsed;
+}
+
+// Return the time taken to read every command of SCRIPT, and set
+// *COMMANDS to how many there were
+static double
+time_parse (char const *script, size_t len, size_t *commands)
+{
+  char *copy = copy_script (script, len);
+  command_stream_t s = make_command_stream_from_buffer (copy, len);
+  command_t command;
+  *commands = 0;
+  double start = seconds_now ();
+  while ((command = read_command_stream (s)))
+    {
+      free_command (command);
+      ++*commands;
+    }
+  double elapsed = seconds_now () - start;
+  free_command_stream (s);
+  free (copy);
+  return elapsed;
+}
+
+// Read SCRIPT into a list of graph nodes, as main does for time travel
+static graph_nodes *
+read_graph (command_stream_t s)
+{
+  int command_number = 1;
+  graph_nodes *node_list = checked_malloc (sizeof (graph_nodes));
+  graph_nodes *last_node = node_list;
+  command_t command;
+  node_list->prev = node_list->next = NULL;
+  node_list->node = NULL;
+  while ((command = read_command_stream (s)))
+    last_node = append_command (last_node, command, &command_number);
+  return node_list;
+}
+
+// Return the time taken to build the time-travel graph of SCRIPT, less
+// PARSE, the time taken to read its commands, and set *NODES and *EDGES to
+// the size of the graph
+static double
+time_graph (char const *script, size_t len, double parse, size_t *nodes,
+            size_t *edges)
+{
+  char *copy = copy_script (script, len);
+  command_stream_t s = make_command_stream_from_buffer (copy, len);
+  double start = seconds_now ();
+  graph_nodes *node_list = read_graph (s);
+  add_all_dependencies (node_list);
+  double elapsed = seconds_now () - start - parse;
+
+  graph_nodes *n;
+  *nodes = *edges = 0;
+  for (n = node_list; n && n->node; n = n->next)
+    {
+      ++*nodes;
+      *edges += n->node->edge_count;
+    }
+  free_nodes (node_list);
+  free_command_stream (s);
+  free (copy);
+  return elapsed;
+}
+
+// Return the time per node that execute_parallel adds to running COUNT
+// independent "/bin/true" commands one at a time.  The path keeps them
+// from running as the true builtin, so each one still forks or spawns.
+static double
+time_schedule (size_t count)
+{
+  static char const line[] = "/bin/true\n\n";
+  size_t n = sizeof line - 1, len = count * n;
+  char *script = checked_malloc (len + 1), *copy;
+  size_t i;
+  for (i = 0; i < count; i++)
+    memcpy (script + n * i, line, n);
+
+  copy = copy_script (script, len);
+  command_stream_t s = make_command_stream_from_buffer (copy, len);
+  command_t command;
+  double start = seconds_now ();
+  while ((command = read_command_stream (s)))
+    execute_command (command, 0);
+  double sequential = seconds_now () - start;
+  free_command_stream (s);
+  free (copy);
+
+  copy = copy_script (script, len);
+  s = make_command_stream_from_buffer (copy, len);
+  graph_nodes *node_list = read_graph (s);
+  add_all_dependencies (node_list);
+  start = seconds_now ();
+  execute_parallel (node_list, 1, 1, -1, NULL, NULL);
+  double parallel = seconds_now () - start;
+  free_command_stream (s);
+  free (copy);
+  free (script);
+  return (parallel - sequential) / count;
+}
+
+// Return the wall time of running ARGV to completion
+static double
+time_run (char **argv)
+{
+  double start = seconds_now ();
+  pid_t child = fork ();
+  if (child == 0)
+    {
+      int null = open ("/dev/null", O_WRONLY);
+      dup2 (null, STDOUT_FILENO);
+      dup2 (null, STDERR_FILENO);
+      execv (argv[0], argv);
+      _exit (127);
+    }
+  int status;
+  if (child < 0 || waitpid (child, &status, 0) < 0)
+    error (1, errno, "%s", argv[0]);
+  if (! WIFEXITED (status) || WEXITSTATUS (status) == 127)
+    error (1, 0, "%s: failed", argv[0]);
+  return seconds_now () - start;
+}
+
+static void
+bench_usage (void)
+{
+  error (1, 0, "usage: %s [-l LABEL] [-r REPEAT] [-s SCHEDULED] "
+         "[-e TIMETRASH] SCRIPT-FILE", program_name);
+}
+
+int
+main (int argc, char **argv)
+{
+  int repeat = 3, scheduled = 1000, opt;
+  char *timetrash = NULL;
+  program_name = argv[0];
+  while ((opt = getopt (argc, argv, "e:l:r:s:")) != -1)
+    switch (opt)
+      {
+      case 'e': timetrash = optarg; break;
+      case 'l': label = optarg; break;
+      case 'r': repeat = atoi (optarg); break;
+      case 's': scheduled = atoi (optarg); break;
+      default: bench_usage ();
+      }
+  if (optind != argc - 1 || repeat < 1)
+    bench_usage ();
+  char *script_file = argv[optind];
+
+  FILE *f = fopen (script_file, "r");
+  if (! f)
+    error (1, errno, "%s: cannot open", script_file);
+  size_t len = 0, size = 1 << 16, n;
+  char *script = checked_malloc (size);
+  while ((n = fread (script + len, 1, size - len, f)) > 0)
+    if ((len += n) == size)
+      script = checked_grow_alloc (script, &size);
+  fclose (f);
+
+  // Keep the best of REPEAT runs of each phase
+  double tokenize = 0, parse = 0, graph = 0;
+  size_t commands = 0, nodes = 0, edges = 0;
+  int i;
+  for (i = 0; i < repeat; i++)
+    {
+      double t = time_tokenize (script, len);
+      tokenize = i && tokenize < t ? tokenize : t;
+      t = time_parse (script, len, &commands);
+      parse = i && parse < t ? parse : t;
+      t = time_graph (script, len, parse, &nodes, &edges);
+      graph = i && graph < t ? graph : t;
+    }
+  report ("script_bytes", len, "B");
+  report ("commands", commands, "count");
+  report ("tokenize", len / tokenize / 1e6, "MB/s");
+  report ("parse", len / parse / 1e6, "MB/s");
+  report ("parse_commands", commands / parse, "commands/s");
+  report ("parse_only", (parse - tokenize) / commands * 1e9, "ns/command");
+  report ("graph_nodes", nodes, "count");
+  report ("graph_edges", edges, "count");
+  report ("graph_build", graph * 1e3, "ms");
+  if (scheduled > 0)
+    report ("schedule_overhead", time_schedule (scheduled) * 1e6, "us/node");
+
+  if (timetrash)
+    {
+      char *sh[] = { "/bin/sh", script_file, NULL };
+      char *seq[] = { timetrash, script_file, NULL };
+      char *tt[] = { timetrash, "-t", script_file, NULL };
+      report ("run_sh", time_run (sh), "s");
+      report ("run_timetrash", time_run (seq), "s");
+      report ("run_timetrash_t", time_run (tt), "s");
+    }
+
+  free (script);
+  return 0;
+}
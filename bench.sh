@@ -0,0 +1,68 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Run the benchmark suite.
+#
+# Each configuration generates a script with bench-gen.sh and times it with
+# timetrash-bench, which prints LABEL<tab>METRIC<tab>VALUE<tab>UNIT lines.
+# The large scripts only time the phases inside timetrash; the small one is
+# also run end to end by /bin/sh and by timetrash with and without -t.
+#
+# With -x fork or -x spawn, times instead sequential runs of scripts of 10
+# to 100000 /bin/true commands with simple commands started that way, for
+# comparing the two.  The path keeps them from running as the true builtin.
+
+usage () {
+  echo >&2 "usage: $0 [-x fork|spawn]"
+  exit 1
+}
+
+method=
+while getopts x: opt; do
+  case $opt in
+    x) method=$OPTARG;;
+    *) usage;;
+  esac
+done
+case $method in
+  '' | fork | spawn) ;;
+  *) usage;;
+esac
+test $OPTIND -gt $# || usage
+
+tmp=bench-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+bench () {
+  label=$1
+  shift
+  ../bench-gen.sh "$@" >$label.sh || exit
+  ../timetrash-bench -l $label $run $label.sh || exit
+}
+
+if test -n "$method"; then
+  for n in 10 1000 10000 100000; do
+    awk -v n=$n 'BEGIN { for (i = 0; i < n; i++) print "/bin/true\n" }' >true-$n.sh
+    start=$(date +%s%N)
+    ../timetrash -x $method true-$n.sh || exit
+    end=$(date +%s%N)
+    echo "true-$n	run_$method	$(((end - start) / 1000000))	ms"
+  done
+  exit
+fi
+
+run='-s 0'
+bench flat-100k -n 100000 -d 0
+bench dense-20k -n 20000 -d 80
+bench pipes-20k -n 20000 -d 20 -p 4
+bench nested-20k -n 20000 -d 20 -s 3
+bench words-20k -n 20000 -d 0 -w 256
+
+run='-s 1000 -e ../timetrash'
+bench run-300 -n 300 -d 20 -p 2 -s 1
+
+) || exit
+
+rm -fr "$tmp"
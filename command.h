@@ -1,5 +1,7 @@
 // UCLA CS 111 Lab 1 command interface
 
+#include <stddef.h>
+
 typedef struct command *command_t;
 typedef struct command_stream *command_stream_t;
 
@@ -9,17 +11,95 @@ typedef struct command_stream *command_stream_t;
    (setting errno) on failure.  */
 command_stream_t make_command_stream (int (*getbyte) (void *), void *arg);
 
+/* Create a command stream that reads the LEN bytes at BUF directly.
+   Words of the commands read point into BUF rather than being copied,
+   so BUF must outlive them; the byte after each word is overwritten
+   with a null byte.  */
+command_stream_t make_command_stream_from_buffer (char *buf, size_t len);
+
 /* Read a command from STREAM; return it, or NULL on EOF.  If there is
    an error, report the error and exit instead of returning.  */
 command_t read_command_stream (command_stream_t stream);
 
+/* Free COMMAND, which must have been returned by read_command_stream,
+   together with everything it points to.  */
+void free_command (command_t command);
+
+/* Free STREAM and every command read from it that has not already been
+   freed.  */
+void free_command_stream (command_stream_t stream);
+
+/* Rewrite COMMAND in place into an equivalent that starts fewer
+   processes: a cat that only feeds one file into a pipeline becomes an
+   input redirect of the next stage, and a plain cat between two stages
+   is dropped.  Unlike the cat, the redirect fails without running the
+   rest of the pipeline if the file cannot be opened.  */
+void optimize_command (command_t command);
+
 /* Print a command to stdout, for debugging.  */
 void print_command (command_t);
 
+/* Return the text of a command on one line, in a new string.  */
+char *command_text (command_t);
+
+/* How simple commands are started: fork and exec, or posix_spawn
+   (the default), which avoids copying the parent's page tables.  */
+enum spawn_method { SPAWN_FORK, SPAWN_POSIX_SPAWN };
+void set_spawn_method (enum spawn_method);
+
+/* If the flag is nonzero, enlarge the pipes of pipelines whose first
+   stage reads a large regular file.  */
+void set_pipe_sizing (int);
+
+/* If the flag is nonzero, start the right side of an && or || command
+   while its left side runs, when the right side writes files only
+   through redirects, and keep what it did only if it should have run.  */
+void set_speculation (int);
+
 /* Execute a command.  Use "time travel" if the integer flag is
    nonzero.  */
 void execute_command (command_t, int);
 
+/* Execute a sequence command as time travel executes a script, running
+   commands that use no common files in parallel.  */
+void execute_time_travel (command_t);
+
 /* Return the exit status of a command, which must have previously been executed.
    Wait for the command, if it is not already finished.  */
 int command_status (command_t);
+
+/* A command running in the background, in a child process of its own.
+   Starting one forks the caller, without exec, which costs a copy of
+   the caller's page tables: about 0.2 ms from a small program, and more
+   the more memory the caller maps.  Many scripts submitted together
+   with execute_time_travel_async share one child.  */
+typedef struct command_handle *command_handle_t;
+
+/* Start executing a command, as execute_command would, and return at
+   once with a handle for it.  */
+command_handle_t execute_command_async (command_t, int);
+
+/* Start executing the COUNT commands at COMMANDS as one time-travel
+   graph, as if they had been read from one script, and return at once
+   with a handle for all of them.  */
+command_handle_t execute_time_travel_async (command_t *commands, size_t count);
+
+/* Return a file descriptor that polls readable once the commands of a
+   handle have finished, or -1 if there is none and only command_poll
+   will tell.  */
+int command_handle_fd (command_handle_t);
+
+/* Return nonzero if the commands of a handle have finished, without
+   waiting.  Their statuses are then known to command_status.  Do not
+   reap the handle's child by any other wait: a command whose status is
+   lost that way fails.  The library itself only waits for children it
+   started.  */
+int command_poll (command_handle_t);
+
+/* Wait for the commands of a handle to finish, and return the status
+   of the last one.  */
+int command_wait (command_handle_t);
+
+/* Free a handle, killing its commands, and every process they started,
+   if they have not finished.  */
+void command_handle_free (command_handle_t);
@@ -0,0 +1,211 @@
+// UCLA CS 111 Lab 1 asynchronous command execution
+
+#define _GNU_SOURCE
+#include "command.h"
+#include "command-internals.h"
+#include "alloc.h"
+#include "time-travel.h"
+
+#include <errno.h>
+#include <error.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* A handle runs its commands in one child process, which writes their
+   statuses into memory shared with the caller.  The caller learns that
+   the child has exited from a pidfd, so that it can poll for it along
+   with its own descriptors; without pidfds, from waitpid alone.  The
+   child leads a process group of its own, so that whatever it starts
+   can be killed with it.  */
+struct command_handle
+{
+  pid_t pid;
+  int fd;		// pidfd of the child, or -1
+  int done;
+  size_t count;
+  command_t *commands;	// the caller's commands, given statuses when done
+  int *statuses;	// shared with the child; -1 until set
+};
+
+/* Return the command of COMMAND that runs last, whose status is that
+   of COMMAND as a whole under time travel.  */
+static command_t
+last_command (command_t command)
+{
+  while (command->type == SEQUENCE_COMMAND)
+    command = command->u.command[1];
+  return command;
+}
+
+/* In the child of handle H, run its commands, as one time-travel graph
+   if TIME_TRAVEL is nonzero and one after the other otherwise.  */
+static void
+run_commands (struct command_handle *h, int time_travel)
+{
+  size_t i;
+  if (! time_travel)
+    {
+      for (i = 0; i < h->count; i++)
+	{
+	  execute_command (h->commands[i], 0);
+	  h->statuses[i] = command_status (h->commands[i]);
+	}
+      return;
+    }
+
+  int command_number = 1;
+  graph_nodes *node_list = checked_malloc (sizeof (graph_nodes));
+  graph_nodes *last_node = node_list;
+  node_list->prev = NULL;
+  node_list->next = NULL;
+  node_list->node = NULL;
+  for (i = 0; i < h->count; i++)
+    last_node = append_command (last_node, h->commands[i], &command_number);
+  add_all_dependencies (node_list);
+
+  if (! travel_max_jobs)
+    setup_travel_jobs (0);
+  // This frees the list and its nodes
+  execute_parallel (node_list, 1, travel_max_jobs, travel_jobserver_fd,
+		    NULL, NULL);
+  for (i = 0; i < h->count; i++)
+    h->statuses[i] = command_status (last_command (h->commands[i]));
+}
+
+static command_handle_t
+start_commands (command_t *commands, size_t count, int time_travel)
+{
+  struct command_handle *h = checked_malloc (sizeof *h);
+  h->done = 0;
+  h->count = count;
+  h->commands = checked_malloc ((count ? count : 1) * sizeof *h->commands);
+  size_t i;
+  for (i = 0; i < count; i++)
+    h->commands[i] = commands[i];
+
+  h->statuses = mmap (NULL, (count ? count : 1) * sizeof *h->statuses,
+		      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+		      -1, 0);
+  if (h->statuses == MAP_FAILED)
+    error (1, errno, "execute_command_async: mmap");
+  for (i = 0; i < count; i++)
+    h->statuses[i] = -1;
+
+  // What the caller has buffered is not the child's to write
+  fflush (NULL);
+  h->pid = fork ();
+  if (h->pid < 0)
+    error (1, errno, "execute_command_async: fork");
+  if (h->pid == 0)
+    {
+      setpgid (0, 0);
+      run_commands (h, time_travel);
+      fflush (NULL);
+      _exit (0);
+    }
+
+  setpgid (h->pid, h->pid); // whichever of the two runs first
+#ifdef SYS_pidfd_open
+  h->fd = syscall (SYS_pidfd_open, h->pid, 0);
+#else
+  h->fd = -1;
+#endif
+  return h;
+}
+
+command_handle_t
+execute_command_async (command_t command, int time_travel)
+{
+  return start_commands (&command, 1, time_travel);
+}
+
+command_handle_t
+execute_time_travel_async (command_t *commands, size_t count)
+{
+  return start_commands (commands, count, 1);
+}
+
+int
+command_handle_fd (command_handle_t h)
+{
+  return h->fd;
+}
+
+/* Reap the child of H, waiting for it if WAIT is nonzero, and give the
+   commands their statuses once it is gone.  A command the child did not
+   get to, because it died first, has the status of the child.  If some
+   other wait reaped the child, that status is lost, and such commands
+   fail with status 1.  */
+static int
+reap (command_handle_t h, int wait)
+{
+  if (h->done)
+    return 1;
+
+  int status = 0;
+  pid_t pid;
+  if (h->fd != -1)
+    {
+      // The pidfd is readable once the child has exited
+      struct pollfd p = { h->fd, POLLIN, 0 };
+      while (poll (&p, 1, wait ? -1 : 0) < 0)
+	if (errno != EINTR)
+	  error (1, errno, "command_poll: poll");
+      if (! p.revents)
+	return 0;
+
+      while ((pid = waitpid (h->pid, &status, 0)) < 0 && errno == EINTR)
+	continue;
+    }
+  else
+    {
+      while ((pid = waitpid (h->pid, &status, wait ? 0 : WNOHANG)) < 0
+	     && errno == EINTR)
+	continue;
+      if (pid == 0)
+	return 0;
+    }
+  if (pid < 0)
+    status = W_EXITCODE (1, 0);
+
+  size_t i;
+  for (i = 0; i < h->count; i++)
+    h->commands[i]->status = h->statuses[i] != -1 ? h->statuses[i] : status;
+  h->done = 1;
+  return 1;
+}
+
+int
+command_poll (command_handle_t h)
+{
+  return reap (h, 0);
+}
+
+int
+command_wait (command_handle_t h)
+{
+  reap (h, 1);
+  return h->count ? command_status (h->commands[h->count - 1]) : 0;
+}
+
+void
+command_handle_free (command_handle_t h)
+{
+  if (! h->done)
+    {
+      kill (- h->pid, SIGKILL);
+      reap (h, 1);
+    }
+  if (h->fd != -1)
+    close (h->fd);
+  munmap (h->statuses, (h->count ? h->count : 1) * sizeof *h->statuses);
+  free (h->commands);
+  free (h);
+}
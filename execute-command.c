@@ -1 +1 @@
-// UCLA CS 111 Lab 1 command execution#include "command.h"#include "command-internals.h"#include <error.h>#include <unistd.h>#include <stdlib.h>#include <string.h>#include <sys/wait.h>#include <sys/stat.h>#include <fcntl.h>#include <stdio.h>#define DEBUG 0intcommand_status (command_t c){  return c->status;}voidexecute_command (command_t cmd, int time_travel){  pid_t child;  int status;  int fd[2];  int fd_in, fd_out;    switch (cmd->type) {    case SIMPLE_COMMAND:      child = fork ();      if (child == 0) { // in child        // handle redirects        if (cmd->input) {          if ((fd_in = open(cmd->input, O_RDONLY, 0666)) == -1)            error(1, 0, "failure to open input file %s", cmd->input);           if (dup2(fd_in, STDIN_FILENO) == -1)            error(1, 0, "failure of input redirect");         }        if (cmd->output) {          if ((fd_out = open(cmd->output, O_WRONLY|O_CREAT|O_TRUNC, 0666)) == -1)            error(1, 0, "failure to open output file %s", cmd->output);          if (dup2(fd_out , STDOUT_FILENO) == -1)            error(1, 0, "failure of output redirect");         }        // execution        char *w;        if(strcmp(cmd->u.word[0], "exec") == 0)  {// skip the exec if it's the first word          execvp(cmd->u.word[1], cmd->u.word + 1);          w = cmd->u.word[1];        } else {          execvp(cmd->u.word[0], cmd->u.word);          w = cmd->u.word[0];        }        error(1, 0, "execute [%s] command failed!", w);      } else if (child > 0) { // in parent        waitpid(child, &status, 0); // wait for child to finish        if (DEBUG) printf("SIMPLE: Returned status %i\tCurrent status %i\n", status, cmd->status);        cmd->status = status;      } else        error(1, 0, "failed to create child process!");             break;        // run left recursively, then run right if applicable    case AND_COMMAND:       execute_command(cmd->u.command[0], time_travel);       if (cmd->u.command[0]->status == 0){        execute_command(cmd->u.command[1], time_travel);        cmd->status = cmd->u.command[1]->status;       } else         cmd->status = cmd->u.command[0]->status;             break;    // run left recursively, then run right if applicable    case OR_COMMAND:      execute_command(cmd->u.command[0], time_travel);       if (cmd->u.command[0]->status != 0){        execute_command(cmd->u.command[1], time_travel);        cmd->status = cmd->u.command[1]->status;       } else         cmd->status = cmd->u.command[0]->status;             break;    // child | parent redirect output of parent to input of child    case PIPE_COMMAND:            if (pipe(fd) == -1)        error(1, 0, "Cannot create pipe!");       child = fork ();      if (child == 0) { // child writes to pipe        close(fd[0]);        if (dup2(fd[1], STDOUT_FILENO) == -1)          error(1, 0, "Cannot dup2 STDOUT from fd[1]!");         execute_command(cmd->u.command[0], time_travel);         close(fd[1]);        exit(cmd->u.command[0]->status);      } else if (child > 0) { // parent reads from pipe           waitpid(child , &status , 0);          if (DEBUG) printf("PIPE: Returned status %i\tCurrent status %i\n", status, cmd->u.command[0]->status);          cmd->u.command[0]->status = status;           close(fd[1]);          if (dup2(fd[0], STDIN_FILENO) == -1)            error(1, 0, "Cannot dup2 STDIN from fd[0]!");          execute_command(cmd->u.command[1], time_travel);           close(fd[0]);          cmd->status = cmd->u.command[1]->status;      } else         error(1, 0, "failed to create child process!");            break;    case SEQUENCE_COMMAND:      execute_command(cmd->u.command[0], time_travel);      execute_command(cmd->u.command[1], time_travel);      cmd->status = cmd->u.command[1]->status;      break;    case SUBSHELL_COMMAND:      execute_command(cmd->u.subshell_command, time_travel);      cmd->status = cmd->u.subshell_command->status;      break;  }}
\ No newline at end of file
+// UCLA CS 111 Lab 1 command execution#define _GNU_SOURCE#include "command.h"#include "command-internals.h"#include "alloc.h"#include "trace.h"#include "signature.h"#include "time-travel.h"#include <errno.h>#include <error.h>#include <limits.h>#include <stdint.h>#include <unistd.h>#include <stdlib.h>#include <string.h>#include <signal.h>#include <sys/mman.h>#include <sys/wait.h>#include <sys/resource.h>#include <sys/stat.h>#include <fcntl.h>#include <time.h>#include <spawn.h>#include <stdio.h>#define DEBUG 0extern char **environ;static enum spawn_method spawn_method = SPAWN_POSIX_SPAWN;static int pipe_sizing;static int speculation;static int speculating; // in the child running a right-hand side early// The largest pipe an unprivileged process may ask for by default#define MAX_PIPE_SIZE (1 << 20)static void execute_pipeline (command_t cmd, int time_travel);voidset_spawn_method (enum spawn_method method){  spawn_method = method;}voidset_pipe_sizing (int flag){  pipe_sizing = flag;}voidset_speculation (int flag){  speculation = flag;}intcommand_status (command_t c){  return c->status;}// Translate a wait status into the exit code a process should report for itstatic intexit_code (int status){  if (WIFSIGNALED (status))    return 128 + WTERMSIG (status);  return WEXITSTATUS (status);}// Apply the redirects of a simple command and exec it; never returnsstatic voidexec_simple_command (command_t cmd){  int fd_in, fd_out;  // handle redirects  if (cmd->input) {    if ((fd_in = open(cmd->input, O_RDONLY, 0666)) == -1)      error(1, 0, "failure to open input file %s", cmd->input);     if (dup2(fd_in, STDIN_FILENO) == -1)      error(1, 0, "failure of input redirect");   }  if (cmd->output) {    if ((fd_out = open(cmd->output, O_WRONLY|O_CREAT|O_TRUNC, 0666)) == -1)      error(1, 0, "failure to open output file %s", cmd->output);    if (dup2(fd_out , STDOUT_FILENO) == -1)      error(1, 0, "failure of output redirect");   }  // execution  char *w;  if(strcmp(cmd->u.word[0], "exec") == 0)  {// skip the exec if it's the first word    execvp(cmd->u.word[1], cmd->u.word + 1);    w = cmd->u.word[1];  } else {    execvp(cmd->u.word[0], cmd->u.word);    w = cmd->u.word[0];  }  error(1, 0, "execute [%s] command failed!", w);}// Start a simple command with posix_spawnp, with fd_in and fd_out (-1 to// inherit) as its stdin and stdout before its own redirects apply.  The// redirect files are opened here, so failures are reported the same way as// in exec_simple_command.  Returns the child's pid, or -1 with cmd->status// set as if the child had exited with status 1.static pid_tspawn_simple_command (command_t cmd, int fd_in, int fd_out){  pid_t child = -1;  int in = -1, out = -1;  posix_spawn_file_actions_t actions;  posix_spawn_file_actions_init(&actions);  // handle redirects  if (cmd->input) {    if ((in = open(cmd->input, O_RDONLY|O_CLOEXEC, 0666)) == -1) {      error(0, 0, "failure to open input file %s", cmd->input);      goto done;    }    fd_in = in;  }  if (cmd->output) {    if ((out = open(cmd->output, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0666)) == -1) {      error(0, 0, "failure to open output file %s", cmd->output);      goto done;    }    fd_out = out;  }  if (fd_in != -1)    posix_spawn_file_actions_adddup2(&actions, fd_in, STDIN_FILENO);  if (fd_out != -1)    posix_spawn_file_actions_adddup2(&actions, fd_out, STDOUT_FILENO);  // execution; skip the exec if it's the first word  char **argv = strcmp(cmd->u.word[0], "exec") == 0 ? cmd->u.word + 1 : cmd->u.word;  if (! argv[0] || posix_spawnp(&child, argv[0], &actions, NULL, argv, environ) != 0) {    error(0, 0, "execute [%s] command failed!", argv[0]);    child = -1;  } done:  if (in != -1)    close(in);  if (out != -1)    close(out);  posix_spawn_file_actions_destroy(&actions);  if (child == -1)    cmd->status = W_EXITCODE(1, 0);  return child;}// Write the len bytes at buf to fd; return 0, or -1 on errorstatic intwrite_all (int fd, char const *buf, size_t len){  while (len) {    ssize_t n = write(fd, buf, len);    if (n < 0 && errno == EINTR)      continue;    if (n <= 0)      return -1;    buf += n;    len -= n;  }  return 0;}// Write as write_all does, for a builtin whose program a closed pipe would// kill: the SIGPIPE is blocked and discarded instead of killing this// process, which sees EPIPEstatic intwrite_output (int fd, char const *buf, size_t len){  sigset_t pipe_set, old_mask, pending;  sigemptyset(&pipe_set);  sigaddset(&pipe_set, SIGPIPE);  sigprocmask(SIG_BLOCK, &pipe_set, &old_mask);  int was_pending = sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE);  int r = write_all(fd, buf, len), saved = errno;  if (r != 0 && errno == EPIPE && !was_pending) {    struct timespec zero = { 0, 0 };    sigtimedwait(&pipe_set, NULL, &zero);  }  sigprocmask(SIG_SETMASK, &old_mask, NULL);  errno = saved;  return r;}// The real programs answer a lone --help or --versionstatic intversion_or_help (char **argv){  return argv[1] && !argv[2]    && (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "--version") == 0);}// Builtins run argv in this process, writing at most limit bytes to fd,// and return its exit code, or 128 plus the signal that would have killed// the program.  They return -1 before doing anything if the arguments// need the real program or the output would exceed limit.static intbuiltin_colon (char **argv, int fd, size_t limit){  return 0;}static intbuiltin_true (char **argv, int fd, size_t limit){  return version_or_help(argv) ? -1 : 0;}static intbuiltin_false (char **argv, int fd, size_t limit){  return version_or_help(argv) ? -1 : 1;}static intbuiltin_echo (char **argv, int fd, size_t limit){  if (version_or_help(argv))    return -1;  int newline = 1;  char **w = argv + 1;  for (; *w && (*w)[0] == '-' && (*w)[1] && strspn(*w + 1, "neE") == strlen(*w + 1); w++) {    if (strchr(*w, 'e')) // escapes are left to the real echo      return -1;    if (strchr(*w, 'n'))      newline = 0;  }  // the words, a space between each two, and the newline  size_t len = newline, n;  char **v;  for (v = w; *v; v++)    len += strlen(*v) + (v != w);  if (len > limit)    return -1;  char small[4096];  char *buf = len <= sizeof small ? small : checked_malloc(len), *p = buf;  for (v = w; *v; v++) {    if (v != w)      *p++ = ' ';    n = strlen(*v);    memcpy(p, *v, n);    p += n;  }  if (newline)    *p++ = '\n';  int code = 0;  if (write_output(fd, buf, p - buf) != 0)    code = errno == EPIPE ? 128 + SIGPIPE : 1;  if (code == 1)    error(0, errno, "echo: write error");  if (buf != small)    free(buf);  return code;}static struct {  char const *name;  int (*run) (char **argv, int fd, size_t limit);} const builtins[] = {  { ":", builtin_colon },  { "true", builtin_true },  { "false", builtin_false },  { "echo", builtin_echo },};// If cmd is a builtin, run it in this process with fd (or its output// redirect) as its stdout, setting its status as if it had been waited// for, and return 1.  Otherwise return 0, having done nothing visible.// A bare exec does nothing but its redirects.static intrun_builtin (command_t cmd, int fd, size_t limit){  char **argv = cmd->u.word;  if (strcmp(argv[0], "exec") == 0)    argv++;  int (*run) (char **, int, size_t) = argv[0] ? NULL : builtin_colon;  size_t i;  for (i = 0; !run && i < sizeof builtins / sizeof *builtins; i++)    if (strcmp(argv[0], builtins[i].name) == 0)      run = builtins[i].run;  if (!run)    return 0;  // The input is not read, but must exist  int in = -1, out = -1, code;  if (cmd->input) {    if ((in = open(cmd->input, O_RDONLY|O_CLOEXEC)) == -1) {      error(0, 0, "failure to open input file %s", cmd->input);      cmd->status = W_EXITCODE(1, 0);      return 1;    }    close(in);  }  if (cmd->output) {    if ((out = open(cmd->output, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0666)) == -1) {      error(0, 0, "failure to open output file %s", cmd->output);      cmd->status = W_EXITCODE(1, 0);      return 1;    }    fd = out;    limit = SIZE_MAX;  }  code = run(argv, fd, limit);  if (out != -1)    close(out);  if (code < 0)    return 0; // the real program truncates the output again  cmd->status = code > 128 ? code - 128 : W_EXITCODE(code, 0);  return 1;}// Record a traced span for cmd, which started at start and was running// its program by exec (-1 if not known), or ran as a builtin if pid is 0static voidtrace_command (command_t cmd, int track, long long start, long long exec,               pid_t pid, struct rusage const *usage){  char extra[64];  char *text = command_text(cmd);  if (exec != -1)    snprintf(extra, sizeof extra, "\"spawn_us\":%lld", exec - start);  else if (pid == 0)    snprintf(extra, sizeof extra, "\"builtin\":true,\"status\":%d", cmd->status);  trace_span(text, track, start, trace_now(), pid, cmd->status, usage,             exec != -1 || pid == 0 ? extra : NULL);  free(text);}// Programs whose only effects are on their stdout and stderr, so that// they can run before it is known whether they should, and whether they// may read their stdinstatic struct {  char const *name;  int reads_stdin;} const pure_programs[] = {  { ":", 0 }, { "true", 0 }, { "false", 0 }, { "echo", 0 }, { "printf", 0 },  { "seq", 0 }, { "sleep", 0 }, { "cat", 1 }, { "head", 1 }, { "tail", 1 },  { "wc", 1 }, { "cmp", 1 }, { "diff", 1 }, { "cut", 1 }, { "grep", 1 },  { "tr", 1 },};// Return 1 if program is pure and never reads stdin, 2 if it is pure but// may read stdin, and 0 if it is not purestatic intpure_program (char const *program){  size_t i;  for (i = 0; i < sizeof pure_programs / sizeof *pure_programs; i++)    if (!strcmp(pure_programs[i].name, program))      return 1 + pure_programs[i].reads_stdin;  return 0;}// Roles of the files a signature names; "-" stands for the standard inputenum { SPEC_STDIN = 4 };static voidnote_file (void *arg, char *name, int role){  *(int *) arg |= strcmp(name, "-") ? role : SPEC_STDIN;}// Return nonzero if every simple command in cmd runs a program with a// signature, so the files it touches are knownstatic intknown_programs (command_t cmd){  int roles = 0;  switch (cmd->type) {    case SIMPLE_COMMAND:      return signature_files(cmd->u.word, note_file, &roles);    case SUBSHELL_COMMAND:      return known_programs(cmd->u.subshell_command);    default:      return known_programs(cmd->u.command[0])        && known_programs(cmd->u.command[1]);  }}// Return nonzero if cmd can run before it is known whether it should: it// runs only pure programs, so it writes files only through output// redirects, which are added to writers, and it reads the shell's stdin// only if stdin_okstatic intspeculable (command_t cmd, int stdin_ok, command_t **writers, size_t *n,            size_t *max_size){  int roles = 0, pure;  switch (cmd->type) {    case SIMPLE_COMMAND:      pure = pure_program(cmd->u.word[0]);      if (!pure || !signature_files(cmd->u.word, note_file, &roles)          || (roles & SIG_WRITE))        return 0;      if (!stdin_ok && !cmd->input && pure == 2          && ((roles & SPEC_STDIN) || !(roles & SIG_READ)))        return 0;      if (cmd->output) {        if ((*n + 1) * sizeof (command_t) > *max_size)          *writers = checked_grow_alloc(*writers, max_size);        (*writers)[(*n)++] = cmd;      }      return 1;    case SUBSHELL_COMMAND:      return !cmd->input && !cmd->output        && speculable(cmd->u.subshell_command, stdin_ok, writers, n, max_size);    case PIPE_COMMAND:      return speculable(cmd->u.command[0], stdin_ok, writers, n, max_size)        && speculable(cmd->u.command[1], 1, writers, n, max_size);    default:      return speculable(cmd->u.command[0], stdin_ok, writers, n, max_size)        && speculable(cmd->u.command[1], stdin_ok, writers, n, max_size);  }}static intlisted (char **words, char const *word){  for (; *words; words++)    if (!strcmp(*words, word))      return 1;  return 0;}// An output redirect of a speculative command, and where it really goestypedef struct diverted_output {  char *target;  char *temp; // next to target, renamed over it if the command should run  int existed;  mode_t mode; // of target, if it existed} diverted_output;// Return the diversions for the output redirects of writers, or NULL if// one of them cannot be diverted safelystatic diverted_output *divert_outputs (command_t *writers, size_t n, char **left_outputs,                char **right_inputs){  diverted_output *d = checked_malloc((n + 1) * sizeof *d);  size_t i, j;  for (i = 0; i < n; i++) {    char *target = writers[i]->output;    struct stat st;    // The right side must see its own writes, and each target must be    // replaceable by a rename without breaking links    for (j = 0; j < i; j++)      if (!strcmp(d[j].target, target))        break;    if (j < i || listed(right_inputs, target))      break;    if (lstat(target, &st) == 0) {      if (!S_ISREG(st.st_mode) || st.st_nlink != 1)        break;      d[i].existed = 1;      d[i].mode = st.st_mode & 07777;    } else if (errno == ENOENT)      d[i].existed = 0;    else      break;    char const *slash = strrchr(target, '/');    int dir_len = slash ? slash - target + 1 : 0;    d[i].target = target;    d[i].temp = checked_malloc(strlen(target) + 64);    sprintf(d[i].temp, "%.*s.%s.spec%ld.%zu", dir_len, target,            target + dir_len, (long) getpid(), i);  }  if (i == n) {    // Nor may the right side read what the left side is still writing    for (; *right_inputs; right_inputs++)      if (listed(left_outputs, *right_inputs))        break;    if (!*right_inputs)      return d;  }  for (j = 0; j < i; j++)    free(d[j].temp);  free(d);  return NULL;}// Run the right side of an && or || command in a child of its own while// the left side runs, with its output redirects diverted to temporary// files and its stdout and stderr buffered.  Once the left side's status// says whether the right side should have run, commit what it did or kill// it and throw that away.  Return 0, having run nothing, if cmd is not one// that can run this way.static intexecute_speculatively (command_t cmd, int time_travel){  command_t left = cmd->u.command[0], right = cmd->u.command[1];  if (!speculation || speculating || !known_programs(left))    return 0;  struct stat st, null_st;  int null_stdin = fstat(STDIN_FILENO, &st) == 0 && S_ISCHR(st.st_mode)    && stat("/dev/null", &null_st) == 0 && st.st_rdev == null_st.st_rdev;  size_t n = 0, max_size = 8 * sizeof (command_t);  command_t *writers = checked_malloc(max_size);  diverted_output *d = NULL;  if (speculable(right, null_stdin, &writers, &n, &max_size)) {    char **left_outputs = extract_io(left, 'o');    char **right_inputs = extract_io(right, 'i');    d = divert_outputs(writers, n, left_outputs, right_inputs);    free(left_outputs);    free(right_inputs);  }  struct stat out, err;  output_buffer buffer;  int *status = MAP_FAILED;  if (d && open_buffer(&buffer,                       fstat(STDOUT_FILENO, &out) == 0                       && fstat(STDERR_FILENO, &err) == 0                       && out.st_dev == err.st_dev && out.st_ino == err.st_ino) == 0) {    status = mmap(NULL, sizeof *status, PROT_READ | PROT_WRITE,                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);    if (status == MAP_FAILED) {      if (buffer.err != buffer.out)        close(buffer.err);      close(buffer.out);    }  }  size_t i;  if (status == MAP_FAILED) {    for (i = 0; d && i < n; i++)      free(d[i].temp);    free(writers);    free(d);    return 0;  }  *status = -1;  pid_t child = fork();  if (child == 0) {    speculating = 1;    setpgid(0, 0); // so a kill reaches everything it started    dup2(buffer.out, STDOUT_FILENO);    dup2(buffer.err, STDERR_FILENO);    for (i = 0; i < n; i++)      writers[i]->output = d[i].temp;    execute_command(right, time_travel);    *status = right->status;    _exit(0);  }  if (child > 0) {    setpgid(child, child);    execute_command(left, time_travel);  }  int run = cmd->type == AND_COMMAND ? left->status == 0 : left->status != 0;  if (child > 0) {    // Until it has stored a status, it cannot have been reaped, so its    // process group is still its own    if (!run && *status == -1)      kill(-child, SIGKILL);    // A pipeline of the left side may have reaped it already    while (waitpid(child, NULL, 0) < 0 && errno == EINTR)      continue;  }  int committed = run && *status != -1;  if (committed) {    for (i = 0; i < n; i++) {      if (d[i].existed)        chmod(d[i].temp, d[i].mode);      // A writer the right side never reached leaves no file      if (rename(d[i].temp, d[i].target) != 0 && errno != ENOENT)        error(0, errno, "%s", d[i].target);    }    copy_buffer(buffer.out, STDOUT_FILENO);    if (buffer.err != buffer.out)      copy_buffer(buffer.err, STDERR_FILENO);    right->status = *status;  } else    for (i = 0; i < n; i++)      unlink(d[i].temp);  if (buffer.err != buffer.out)    close(buffer.err);  close(buffer.out);  munmap(status, sizeof *status);  for (i = 0; i < n; i++)    free(d[i].temp);  free(d);  free(writers);  // Without a child, or if it died before finishing, run it for real  if (run && !committed)    execute_command(right, time_travel);  cmd->status = run ? right->status : left->status;  return 1;}voidexecute_command (command_t cmd, int time_travel){  pid_t child;  int status;  struct rusage usage;  long long start = tracing ? trace_now() : 0, exec = -1;    switch (cmd->type) {    case SIMPLE_COMMAND:      if (run_builtin(cmd, STDOUT_FILENO, SIZE_MAX)) {        if (tracing)          trace_command(cmd, trace_track, start, -1, 0, NULL);        break;      }      if (spawn_method == SPAWN_POSIX_SPAWN) {        child = spawn_simple_command(cmd, -1, -1);        if (child > 0) {          if (tracing)            exec = trace_now();          wait4(child, &status, 0, &usage);          cmd->status = status;          if (tracing)            trace_command(cmd, trace_track, start, exec, child, &usage);        }        break;      }      child = fork ();      if (child == 0) { // in child        exec_simple_command(cmd);      } else if (child > 0) { // in parent        wait4(child, &status, 0, &usage); // wait for child to finish        if (DEBUG) printf("SIMPLE: Returned status %i\tCurrent status %i\n", status, cmd->status);        cmd->status = status;        if (tracing)          trace_command(cmd, trace_track, start, -1, child, &usage);      } else        error(1, 0, "failed to create child process!");             break;        // run left recursively, then run right if applicable    case AND_COMMAND:       if (execute_speculatively(cmd, time_travel))        break;      execute_command(cmd->u.command[0], time_travel);       if (cmd->u.command[0]->status == 0){        execute_command(cmd->u.command[1], time_travel);        cmd->status = cmd->u.command[1]->status;       } else         cmd->status = cmd->u.command[0]->status;             break;    // run left recursively, then run right if applicable    case OR_COMMAND:      if (execute_speculatively(cmd, time_travel))        break;      execute_command(cmd->u.command[0], time_travel);       if (cmd->u.command[0]->status != 0){        execute_command(cmd->u.command[1], time_travel);        cmd->status = cmd->u.command[1]->status;       } else         cmd->status = cmd->u.command[0]->status;             break;    // run every stage of the pipeline at once    case PIPE_COMMAND:      execute_pipeline(cmd, time_travel);      break;    case SEQUENCE_COMMAND:      execute_command(cmd->u.command[0], time_travel);      execute_command(cmd->u.command[1], time_travel);      cmd->status = cmd->u.command[1]->status;      break;    // with time travel, a sequence in a subshell gets a graph of its own    case SUBSHELL_COMMAND:      if (time_travel && cmd->u.subshell_command->type == SEQUENCE_COMMAND)        execute_time_travel(cmd->u.subshell_command);      else        execute_command(cmd->u.subshell_command, time_travel);      cmd->status = cmd->u.subshell_command->status;      break;  }}// Append the stages of the pipeline rooted at cmd to stages, left to rightstatic voidcollect_stages (command_t cmd, command_t **stages, size_t *n, size_t *max_size){  if (cmd->type == PIPE_COMMAND) {    collect_stages(cmd->u.command[0], stages, n, max_size);    collect_stages(cmd->u.command[1], stages, n, max_size);    return;  }  if ((*n + 1) * sizeof (command_t) > *max_size)    *stages = checked_grow_alloc(*stages, max_size);  (*stages)[(*n)++] = cmd;}// A pipeline reports the status of its last stagestatic voidset_pipe_status (command_t cmd){  if (cmd->type != PIPE_COMMAND)    return;  set_pipe_status(cmd->u.command[0]);  set_pipe_status(cmd->u.command[1]);  cmd->status = cmd->u.command[1]->status;}// Start every stage of a (possibly nested) PIPE_COMMAND with its pipe ends in// place, then reap them all.  Simple stages are spawned, or exec directly in// the forked child; other stages run execute_command in a forked child.// When tracing, each stage is a span on a track named by its pid.  With// pipe sizing, a pipeline that starts by reading a large file gets pipes as// large as the file, up to MAX_PIPE_SIZE, so that fewer context switches// move its data.static voidexecute_pipeline (command_t cmd, int time_travel){  size_t n = 0, max_size = 4 * sizeof (command_t);  command_t *stages = checked_malloc(max_size);  collect_stages(cmd, &stages, &n, &max_size);  pid_t *pids = checked_malloc(n * sizeof (pid_t));  long long *starts = checked_malloc(n * sizeof (long long));  long long *execs = checked_malloc(n * sizeof (long long));  int pipe_size = 0;  struct stat st;  if (pipe_sizing && stages[0]->input && stat(stages[0]->input, &st) == 0      && S_ISREG(st.st_mode) && st.st_size > 65536)    pipe_size = st.st_size < MAX_PIPE_SIZE ? st.st_size : MAX_PIPE_SIZE;  int prev_read = -1; // read end of the pipe feeding stage i  size_t i;  for (i = 0; i < n; i++) {    int fd[2] = { -1, -1 };    if (i + 1 < n && pipe2(fd, O_CLOEXEC) == -1)      error(1, 0, "Cannot create pipe!");     if (fd[1] != -1 && pipe_size)      fcntl(fd[1], F_SETPIPE_SZ, pipe_size); // the default size will do    pid_t child;    starts[i] = tracing ? trace_now() : 0;    execs[i] = -1;    // A builtin writes into the new, empty pipe before its reader starts,    // so only as much as the pipe surely holds    if (stages[i]->type == SIMPLE_COMMAND        && run_builtin(stages[i], fd[1] != -1 ? fd[1] : STDOUT_FILENO,                       fd[1] != -1 ? PIPE_BUF : SIZE_MAX)) {      child = -1;      if (tracing)        trace_command(stages[i], trace_track, starts[i], -1, 0, NULL);    } else if (spawn_method == SPAWN_POSIX_SPAWN && stages[i]->type == SIMPLE_COMMAND) {      child = spawn_simple_command(stages[i], prev_read, fd[1]);      if (tracing)        execs[i] = trace_now();    } else if ((child = fork ()) == 0) { // stage reads prev_read, writes fd[1]      trace_track = getpid();      if (prev_read != -1) {        if (dup2(prev_read, STDIN_FILENO) == -1)          error(1, 0, "Cannot dup2 STDIN from fd[0]!");        close(prev_read);      }      if (fd[1] != -1) {        close(fd[0]);        if (dup2(fd[1], STDOUT_FILENO) == -1)          error(1, 0, "Cannot dup2 STDOUT from fd[1]!");         close(fd[1]);      }      if (stages[i]->type == SIMPLE_COMMAND)        exec_simple_command(stages[i]);      execute_command(stages[i], time_travel);      _exit(exit_code(stages[i]->status));    } else if (child < 0)      error(1, 0, "failed to create child process!");    pids[i] = child; // -1 if it ran as a builtin or spawning failed    if (prev_read != -1)      close(prev_read);    if (fd[1] != -1)      close(fd[1]);    prev_read = fd[0];  }  // Reap the stages as they finish, so that each one's end time is right,  // and leave other children, such as a speculative right side of an && or  // || whose left side this is, to whoever waits for them  size_t left = 0;  for (i = 0; i < n; i++)    left += pids[i] != -1;  while (left) {    int status;    struct rusage usage;    pid_t child = wait_own(pids, n, &status, 0, &usage);    if (child == -1) {      if (errno == EINTR)        continue;      error(1, errno, "execute_pipeline: wait");    }    for (i = 0; i < n && pids[i] != child; i++)      continue;    if (i == n)      continue;    if (DEBUG) printf("PIPE: stage %i returned status %i\n", (int) i, status);    stages[i]->status = status;    pids[i] = -1;    left--;    if (tracing)      trace_command(stages[i], child, starts[i], execs[i], child, &usage);  }  set_pipe_status(cmd);  free(pids);  free(starts);  free(execs);  free(stages);}
\ No newline at end of file
@@ -0,0 +1,124 @@
+// UCLA CS 111 Lab 1 GNU make jobserver client
+
+#define _GNU_SOURCE
+#include "jobserver.h"
+#include "alloc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Our own read description of the token pipe, so that it can be made
+// non-blocking without affecting make or other clients
+static int read_fd = -1;
+static int write_fd = -1;
+
+// Bytes of the tokens currently held, to be written back as they were read
+static char *tokens;
+static size_t token_count;
+static size_t max_token_count;
+
+// Open the read side of the pipe behind inherited descriptor FD afresh
+static int
+reopen_fd (int fd, int flags)
+{
+  char path[64];
+  if (fd < 0 || fcntl (fd, F_GETFD) == -1)
+    return -1;
+  snprintf (path, sizeof path, "/proc/self/fd/%d", fd);
+  return open (path, flags | O_NONBLOCK | O_CLOEXEC);
+}
+
+int
+jobserver_connect (void)
+{
+  char const *flags = getenv ("MAKEFLAGS");
+  if (! flags)
+    return -1;
+
+  // make passes --jobserver-auth=R,W or =fifo:PATH; before 4.2 it was
+  // --jobserver-fds=R,W.  The last one given wins.
+  char const *auth = NULL, *p;
+  for (p = flags; (p = strstr (p, "--jobserver-")); p++)
+    if (! strncmp (p, "--jobserver-auth=", 17))
+      auth = p + 17;
+    else if (! strncmp (p, "--jobserver-fds=", 16))
+      auth = p + 16;
+  if (! auth)
+    return -1;
+
+  if (! strncmp (auth, "fifo:", 5))
+    {
+      size_t len = strcspn (auth + 5, " ");
+      char *path = checked_malloc (len + 1);
+      memcpy (path, auth + 5, len);
+      path[len] = 0;
+      read_fd = open (path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+      write_fd = open (path, O_WRONLY | O_CLOEXEC);
+      free (path);
+    }
+  else
+    {
+      int r, w;
+      if (sscanf (auth, "%d,%d", &r, &w) != 2)
+        return -1;
+      read_fd = reopen_fd (r, O_RDONLY);
+      write_fd = w >= 0 && fcntl (w, F_GETFD) != -1 ? w : -1;
+    }
+
+  if (read_fd < 0 || write_fd < 0)
+    {
+      if (read_fd >= 0)
+        close (read_fd);
+      read_fd = write_fd = -1;
+    }
+  return read_fd;
+}
+
+int
+jobserver_create (int count)
+{
+  int fds[2];
+  if (count > PIPE_BUF || pipe2 (fds, O_NONBLOCK | O_CLOEXEC) == -1)
+    return -1;
+  for (; count > 0; count--)
+    if (write (fds[1], "+", 1) != 1)
+      {
+        close (fds[0]);
+        close (fds[1]);
+        return -1;
+      }
+  read_fd = fds[0];
+  write_fd = fds[1];
+  return read_fd;
+}
+
+int
+jobserver_acquire (void)
+{
+  char c;
+  if (read_fd < 0 || read (read_fd, &c, 1) != 1)
+    return 0;
+  if (token_count == max_token_count)
+    {
+      size_t size = max_token_count ? max_token_count : 8;
+      tokens = checked_grow_alloc (tokens, &size);
+      max_token_count = size;
+    }
+  tokens[token_count++] = c;
+  return 1;
+}
+
+void
+jobserver_release (void)
+{
+  if (! token_count)
+    return;
+  char c = tokens[--token_count];
+  while (write (write_fd, &c, 1) == -1 && errno == EINTR)
+    continue;
+}
@@ -0,0 +1,18 @@
+// UCLA CS 111 Lab 1 GNU make jobserver client
+
+/* Connect to the jobserver advertised in MAKEFLAGS, if any.  Return a
+   descriptor that becomes readable when a job token may be available,
+   or -1 if there is no usable jobserver.  */
+int jobserver_connect (void);
+
+/* Create a jobserver of our own holding TOKENS tokens, for nested time
+   travel to share.  Return its descriptor as for jobserver_connect, or -1
+   on failure.  */
+int jobserver_create (int tokens);
+
+/* Take a job token without blocking.  Return 1 on success, 0 if none
+   is available right now.  */
+int jobserver_acquire (void);
+
+/* Return a token taken by jobserver_acquire.  */
+void jobserver_release (void);
@@ -2,28 +2,41 @@
 
 #include <errno.h>
 #include <error.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include "command.h"
 #include "command-internals.h"
 #include "alloc.h"
+#include "signature.h"
+#include "time-travel.h"
+#include "trace.h"
 #include <string.h>
 
 #define DEBUG 0
-#define WORDMIN 2
 
 static char const *program_name;
 static char const *script_name;
+static FILE *script_file; // the script last opened, if read through stdio and seekable
+
+// A script that open_script mapped, to unmap once its stream is freed
+typedef struct mapped_script {
+    char *addr; // NULL if the script is not mapped
+    size_t len;
+} mapped_script;
+static mapped_script *script_maps; // one per script
 
 static void
 usage (void)
 {
-    error (1, 0, "usage: %s [-pt] SCRIPT-FILE", program_name);
+    error (1, 0, "usage: %s [-abptOS] [-c CACHE] [-i STATE] [-G DOT-FILE] [-j JOBS] [-m MEMORY] [-P PROFILE] [-s SIGNATURE-FILE] [-T TRACE] [-x fork|spawn] SCRIPT-FILE...", program_name);
 }
 
 static int
@@ -32,45 +45,86 @@ get_next_byte (void *stream)
     return getc (stream);
 }
 
-// typedefs
-typedef struct graph_node {
-    command_t command;
-    int seq_no;
-    char **inputs;
-    char **outputs;
-    struct graph_node **out_edges;
-    int max_edge_count;
-    int edge_count;
-    int in_edges;
-} graph_node;
-
-typedef struct graph_nodes {
-    graph_node *node;
-    struct graph_nodes *next;
-    struct graph_nodes *prev;
-} graph_nodes;
-
-// TODO: split up disconnected graphs and run independently
-typedef struct graph_list {
-    graph_nodes *graph;
-    struct graph_list *next;
-} graph_list;
-
-typedef struct child_node {
-    pid_t child;
-    graph_node *node;
-    struct child_node *next;
-} child_node;
+// Opens script_name as a command stream.  Regular files are mapped and
+// parsed in place, and the mapping is recorded in map; anything else
+// (pipes, terminals) is read byte by byte, or if online is not NULL,
+// through it as its bytes arrive.
+static command_stream_t
+open_script (char const *script_name, online_script *online, mapped_script *map)
+{
+    FILE *script_stream = fopen (script_name, "r");
+    if (! script_stream)
+        error (1, errno, "%s: cannot open", script_name);
+
+    script_file = NULL;
+    if (online)
+        online->fd = -1;
+    struct stat st;
+    if (fstat (fileno (script_stream), &st) == 0 && S_ISREG (st.st_mode)) {
+        if (st.st_size == 0) {
+            fclose (script_stream);
+            return make_command_stream_from_buffer (NULL, 0);
+        }
+        // Private writable mapping: words are terminated in place
+        char *script = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE, fileno (script_stream), 0);
+        if (script != MAP_FAILED) {
+            fclose (script_stream);
+            map->addr = script;
+            map->len = st.st_size;
+            madvise (script, st.st_size, MADV_SEQUENTIAL);
+            return make_command_stream_from_buffer (script, st.st_size);
+        }
+    }
+
+    if (online) {
+        online->fd = fileno (script_stream);
+        online->pos = online->len = 0;
+        fcntl (online->fd, F_SETFD, FD_CLOEXEC);
+        return make_command_stream (online_byte, online);
+    }
+
+    // Commands run while the script is still being read, and a forked child
+    // that exits would seek a buffered script back to its own read position,
+    // so the offset is synced before each command runs
+    script_file = lseek (fileno (script_stream), 0, SEEK_CUR) != -1 ? script_stream : NULL;
+    return make_command_stream (get_next_byte, script_stream);
+}
+
+// Returns the kB of a size in KiB, or with a suffix of b, K, M, G or T in
+// those units, or -1 if it is not one
+static long
+parse_memory (char const *arg)
+{
+    char *end;
+    double size = strtod (arg, &end);
+    char const *units = "bKMGT";
+    char const *unit = *end ? strchr (units, *end) : units + 1;
+    if (end == arg || size < 0 || !unit || (*end && end[1]))
+        return -1;
+    if (unit == units)
+        return size / 1024;
+    for (; unit > units + 1; unit--)
+        size *= 1024;
+    return size;
+}
+
+// Returns 1 if each script named by names is a regular file, or missing
+static int
+regular_scripts (char **names, int count)
+{
+    struct stat st;
+    int s;
+    for (s = 0; s < count; s++)
+        if (stat (names[s], &st) == 0 && !S_ISREG (st.st_mode))
+            return 0;
+    return 1;
+}
 
 // functions
-graph_node *parse_io (command_t command, int command_number);
-char **extract_io (command_t command, char io);
-int contains (char *w, char **words);
-int intersect (char **words1, char **words2);
-void add_edge (graph_node *src, graph_node *dst);
-command_t execute_parallel (graph_nodes *node_list, int time_travel);
-void decrement (graph_node *node);
-graph_nodes *append_command (graph_nodes *last_node, command_t command, int *command_number);
+graph_nodes *read_scripts (char **names, int count, command_stream_t *streams, int *ends);
+void last_commands_of (graph_nodes *node_list, int *ends, command_t *last_commands);
+graph_nodes *travel_online (char **names, int count, command_stream_t *streams, int *ends, profile *prof, run_state *state);
 
 int
 main (int argc, char **argv)
@@ -79,351 +133,352 @@ main (int argc, char **argv)
     int command_number = 1;
     int print_tree = 0;
     int time_travel = 0;
+    int max_jobs = 0;
+    char const *profile_name = NULL;
+    char const *state_name = NULL;
+    char const *cache_name = NULL;
+    int analyzing = 0;
+    char const *dot_name = NULL;
+    char *end;
     program_name = argv[0];
 
     for (;;)
-        switch (getopt (argc, argv, "pt"))
+        switch (getopt (argc, argv, "abptOSc:G:i:j:m:P:s:T:x:"))
             {
+            case 'a': analyzing = 1; break;
+            case 'b': travel_buffered = 1; break;
             case 'p': print_tree = 1; break;
             case 't': time_travel = 1; break;
+            case 'O':
+                travel_optimizing = 1;
+                set_pipe_sizing (1);
+                break;
+            case 'S': set_speculation (1); break;
+            case 'c': cache_name = optarg; break;
+            case 'G':
+                analyzing = 1;
+                dot_name = optarg;
+                break;
+            case 'i': state_name = optarg; break;
+            case 'j':
+                max_jobs = strtol (optarg, &end, 10);
+                if (*end || max_jobs < 1)
+                    usage ();
+                break;
+            case 'm':
+                travel_memory_budget = parse_memory (optarg);
+                if (travel_memory_budget < 1)
+                    usage ();
+                break;
+            case 'P': profile_name = optarg; break;
+            case 's': load_signatures (optarg); break;
+            case 'T': trace_open (optarg); break;
+            case 'x':
+                if (!strcmp (optarg, "fork"))
+                    set_spawn_method (SPAWN_FORK);
+                else if (!strcmp (optarg, "spawn"))
+                    set_spawn_method (SPAWN_POSIX_SPAWN);
+                else
+                    usage ();
+                break;
             default: usage (); break;
             case -1: goto options_exhausted;
             }
     options_exhausted:;
 
-    // There must be exactly one file argument.
-    if (optind != argc - 1)
+    // Incremental runs, buffered output and memory budgets are time
+    // travel's alone
+    if (!time_travel && (state_name || travel_buffered || travel_memory_budget))
         usage ();
 
-    script_name = argv[optind];
-    FILE *script_stream = fopen (script_name, "r");
-    if (! script_stream)
-        error (1, errno, "%s: cannot open", script_name);
-    command_stream_t command_stream =
-        make_command_stream (get_next_byte, script_stream);
+    // Each file argument is a script.  Several scripts run one after the
+    // other, or with time travel as a single graph, where commands of
+    // different scripts that use the same files run in argument order.
+    if (optind == argc)
+        usage ();
+    char **script_names = argv + optind;
+    int script_count = argc - optind;
+    if (cache_name && script_count > 1)
+        error (1, 0, "-c takes a single script");
+    command_stream_t *streams = (command_stream_t *) checked_malloc (script_count * sizeof (command_stream_t));
+    command_t *last_commands = (command_t *) checked_malloc (script_count * sizeof (command_t));
+    int *script_ends = (int *) checked_malloc (script_count * sizeof (int)); // seq_no of the last node of each
+    script_maps = (mapped_script *) checked_malloc (script_count * sizeof (mapped_script));
+    int s;
+    for (s = 0; s < script_count; s++) {
+        streams[s] = NULL;
+        last_commands[s] = NULL;
+        script_maps[s].addr = NULL;
+    }
+    script_name = script_names[0];
+
+    // A cache made from the same script holds its commands and graph ready
+    // to run.  Scripts that are not regular files are not cached.
+    unsigned long long script_hash;
+    graph_nodes *node_list = NULL;
+    if (cache_name && !print_tree && !hash_script (script_name, &script_hash))
+        cache_name = NULL;
+    if (cache_name && (node_list = load_cache (cache_name, script_hash))) {
+        graph_nodes *n;
+        script_ends[0] = 0;
+        for (n = node_list; n && n->node; n = n->next)
+            script_ends[0] = n->node->seq_no;
+    }
 
-    command_t last_command = NULL;
     command_t command;
 
-    if (print_tree || !time_travel) {
-        while ((command = read_command_stream (command_stream))) {
-            if (print_tree) {
-                printf ("# %d\n", command_number++);
-                print_command (command);
-            } else {
-                last_command = command;
-                execute_command (command, time_travel);
+    if (tracing && !print_tree && !time_travel && !analyzing)
+        trace_name_track (trace_track, "main");
+    if (print_tree || (!time_travel && !analyzing && !cache_name)) {
+        // Scripts are opened in turn, as earlier ones may write later ones
+        for (s = 0; s < script_count; s++) {
+            script_name = script_names[s];
+            streams[s] = open_script (script_name, NULL, &script_maps[s]);
+            while ((command = read_command_stream (streams[s]))) {
+                if (travel_optimizing)
+                    optimize_command (command);
+                if (print_tree) {
+                    printf ("# %d\n", command_number++);
+                    print_command (command);
+                    free_command (command);
+                } else {
+                    if (last_commands[s])
+                        free_command (last_commands[s]);
+                    last_commands[s] = command;
+                    if (script_file)
+                        fflush (script_file); // seeks to what has been read
+                    execute_command (command, time_travel);
+                }
             }
         }
-    } else {
-        if (DEBUG) printf("Commencing time travel\n");
-        graph_nodes *node_list = (graph_nodes *) checked_malloc (sizeof (graph_nodes));
-        graph_nodes *last_node = node_list;
-        node_list->prev = NULL;
-        node_list->node = NULL;
-        
-        // Parse out input/outputs; create list of graph_nodes (node_list)
-        while ((command = read_command_stream (command_stream))) {
-            last_node = append_command (last_node, command, &command_number);
+    } else if (analyzing) {
+        // Build the graph as time travel would, but only describe it
+        if (!node_list) {
+            node_list = read_scripts (script_names, script_count, streams, script_ends);
+            if (cache_name)
+                save_cache (node_list, cache_name, script_hash);
         }
-        
-        // Fill out dependency edges in node_list
-        last_node = node_list;
-        graph_nodes *prev_node = node_list;
-        while (last_node) {
-            while (prev_node->node->seq_no < last_node->node->seq_no) {
-                if (intersect (last_node->node->outputs, prev_node->node->inputs)
-                    || intersect (last_node->node->inputs, prev_node->node->outputs)
-                    || intersect (last_node->node->outputs, prev_node->node->outputs)) { // Avoid interleaving output files
-                    add_edge (prev_node->node, last_node->node);
-                }
-                prev_node = prev_node->next;
+        profile prof = { { NULL, 0, 0, NULL, 0 }, NULL, 0, NULL, 0 };
+        graph_nodes *last_node;
+        if (profile_name) {
+            load_profile (&prof, profile_name);
+            for (last_node = node_list; last_node->node; last_node = last_node->next) {
+                last_node->node->profile_id = profile_id (&prof, command_text (last_node->node->command));
+                if (!last_node->next)
+                    break;
             }
-            prev_node = node_list;
-            last_node = last_node->next;
+            rank_nodes (last_node, &prof);
         }
-        
-        // TODO: split up disconnected graphs and run separately
-        
-        // Execute the graph_nodes
-        last_command = execute_parallel (node_list, time_travel);
-    }
+        FILE *dot = NULL;
+        if (dot_name && !(dot = fopen (dot_name, "w")))
+            error (1, errno, "%s: cannot open", dot_name);
+        analyze_graph (node_list, profile_name ? &prof : NULL, max_jobs ? max_jobs : 8, dot);
+        if (dot && fclose (dot) != 0)
+            error (1, errno, "%s: write error", dot_name);
+        if (profile_name)
+            free_profile (&prof);
+        free_nodes (node_list);
+    } else if (!time_travel) {
+        // Run the cached nodes in script order, as the script's commands
+        // would have run
+        if (!node_list) {
+            node_list = read_scripts (script_names, script_count, streams, script_ends);
+            save_cache (node_list, cache_name, script_hash);
+        }
+        last_commands_of (node_list, script_ends, last_commands);
+        graph_nodes *n;
+        for (n = node_list; n && n->node; n = n->next)
+            execute_command (n->node->command, 0);
+        free_nodes (node_list);
+    } else {
+        if (DEBUG) printf("Commencing time travel\n");
+        graph_nodes *last_node;
 
-    return print_tree || !last_command ? 0 : command_status (last_command);
-}
+        // TODO: split up disconnected graphs and run separately
+        setup_travel_jobs (max_jobs);
 
-// Allocates a graph_node instance that points to command and holds dependency info
-graph_node *parse_io (command_t command, int command_number) {
-    graph_node *node = (graph_node *) checked_malloc (sizeof (graph_node));
-    node->command = command;
-    node->seq_no = command_number;
-    node->outputs = extract_io (command, 'o');
-    node->inputs = extract_io (command, 'i');
-    node->in_edges = 0;
-    node->max_edge_count = 0;
-    node->edge_count = 0;
-    node->out_edges = NULL;
-
-    if (DEBUG) {
-        printf ("\n\toutputs: ");
-        char **w = node->outputs;
-        while (*w) {
-            printf("%s ", *w);
-            *w++;
-        }
-        printf ("\n\tinputs: ");
-        w = node->inputs;
-        while (*w) {
-            printf("%s ", *w);
-            *w++;
-        }
-        printf ("\n");
-    }
-    return node;
-}
+        // Memory admission learns the nodes' peaks in a profile, which is
+        // not saved without -P
+        profile prof = { { NULL, 0, 0, NULL, 0 }, NULL, 0, NULL, 0 };
+        int profiling = profile_name || travel_memory_budget;
+        if (profile_name)
+            load_profile (&prof, profile_name);
+        run_state state = { { NULL, 0, 0, NULL, 0 }, NULL, 0 };
+        if (state_name)
+            load_state (&state, state_name);
 
-// Returns list of words from command that are classified as input/output ('i' or 'o')
-char **extract_io (command_t command, char io) {
-    size_t max_word_count = WORDMIN;
-    size_t max_size = max_word_count * sizeof (char *);
-    size_t word_count = 0;
-    char **words = (char **) checked_malloc (max_size);
-    char **words1 = NULL, **words2 = NULL;
-    
-    if (command->type == SIMPLE_COMMAND) {
-        if (io == 'o') {
-            if (command->output) {
-                words[word_count] = command->output;
-                word_count++;
+        if (!node_list && !regular_scripts (script_names, script_count)) {
+            // Scripts still being written, such as pipes, run as they are
+            // read, without ranks from the profile
+            node_list = travel_online (script_names, script_count, streams, script_ends,
+                                       profiling ? &prof : NULL, state_name ? &state : NULL);
+            last_commands_of (node_list, script_ends, last_commands);
+            free_nodes (node_list);
+        } else {
+            if (!node_list) {
+                // Parse out input/outputs and fill out dependency edges
+                node_list = read_scripts (script_names, script_count, streams, script_ends);
+                if (cache_name)
+                    save_cache (node_list, cache_name, script_hash);
             }
-        } else if (io == 'i') {
-            if (command->input) {
-                words[word_count] = command->input;
-                word_count++;
-                words[word_count] = 0;
-            }
-            
-            char **w = command->u.word;
-            while (*w && *w[0] != '-' && !contains(*w, words)) {
-                words[word_count] = *w;
-                word_count++;
-                if (word_count == max_word_count) {
-                    words = checked_grow_alloc (words, &max_size);
-                    max_word_count = max_size / (sizeof (char *));
-                }
-                words[word_count] = 0;
-                *++w;
-            }
-        }
-    } else if (command->type == SUBSHELL_COMMAND) { // Note: not supporting redirects after subshells
-        words1 = extract_io (command->u.subshell_command, io);
-    } else {
-        words1 = extract_io (command->u.command[0], io);
-        words2 = extract_io (command->u.command[1], io);
-    }
-    
-    words[word_count] = 0;
-    
-    // append words1/2 to words while skipping repeats
-    char **w;
-    if (words1) {
-        w = words1;
-        while (*w) {
-            if (!contains(*w, words)) {
-                words[word_count] = *w;
-                word_count++;
-                if (word_count == max_word_count) {
-                    words = checked_grow_alloc (words, &max_size);
-                    max_word_count = max_size / (sizeof (char *));
+            last_commands_of (node_list, script_ends, last_commands);
+
+            // With a profile, start the nodes on the longest remaining paths first
+            if (profiling) {
+                for (last_node = node_list; last_node->node; last_node = last_node->next) {
+                    last_node->node->profile_id = profile_id (&prof, command_text (last_node->node->command));
+                    if (!last_node->next)
+                        break;
                 }
-                words[word_count] = 0;
+                if (profile_name)
+                    rank_nodes (last_node, &prof);
             }
-            *w++;
+
+            // With a state file, nodes that are up to date are not run again
+            if (state_name)
+                for (last_node = node_list; last_node && last_node->node; last_node = last_node->next)
+                    last_node->node->state_id = state_id (&state, command_text (last_node->node->command));
+
+            // Execute the graph_nodes
+            execute_parallel (node_list, time_travel, travel_max_jobs, travel_jobserver_fd,
+                              profiling ? &prof : NULL, state_name ? &state : NULL);
         }
-        free (words1);
-    }
-    words[word_count] = 0;
-
-    if (words2) {
-        w = words2;
-    
-        while (*w) {
-            if (!contains(*w, words)) {
-                words[word_count] = *w;
-                word_count++;
-                if (word_count == max_word_count) {
-                    words = checked_grow_alloc (words, &max_size);
-                    max_word_count = max_size / (sizeof (char *));
-                }
-                words[word_count] = 0;
-            }
-            *w++;
+        if (profile_name)
+            save_profile (&prof, profile_name);
+        if (profiling)
+            free_profile (&prof);
+        if (state_name) {
+            save_state (&state, state_name);
+            free_state (&state);
         }
-        free (words2);
     }
-    words[word_count] = 0;
-    return words;
-}
 
-// Returns 1 if words1 and words2 intersect
-int intersect (char **words1, char **words2) {
-    while (*words1) {
-        if (contains (*words1, words2)) {
-            return 1;
-        }
-        *words1++;
+    // Exit as the last command did; its status is a wait status.  With
+    // several scripts, report how each one ended, and exit as the first
+    // one that failed.
+    int exit_code = 0;
+    for (s = 0; s < script_count; s++) {
+        int status = print_tree || !last_commands[s] ? 0 : command_status (last_commands[s]);
+        int code = WIFSIGNALED (status) ? 128 + WTERMSIG (status) : WEXITSTATUS (status);
+        if (script_count > 1 && !print_tree)
+            fprintf (stderr, "%s: exit status %d\n", script_names[s], code);
+        if (!exit_code)
+            exit_code = code;
+        if (streams[s])
+            free_command_stream (streams[s]);
+        if (script_maps[s].addr)
+            munmap (script_maps[s].addr, script_maps[s].len);
     }
-    return 0;
+    free (streams);
+    free (script_maps);
+    free (last_commands);
+    free (script_ends);
+    trace_close ();
+    return exit_code;
 }
 
-// Returns 1 if words contains w
-int contains (char *w, char **words) {
-    while (*words) {
-        if (!strcmp (w, *words)) {
-            return 1;
+// Reads the scripts named by names into one list of nodes with the edges
+// between them, keeping their streams in streams and the seq_no of the last
+// node of each in ends
+graph_nodes *read_scripts (char **names, int count, command_stream_t *streams, int *ends) {
+    int command_number = 1;
+    command_t command;
+    graph_nodes *node_list = (graph_nodes *) checked_malloc (sizeof (graph_nodes));
+    graph_nodes *last_node = node_list;
+    node_list->prev = NULL;
+    node_list->next = NULL;
+    node_list->node = NULL;
+    int s;
+    for (s = 0; s < count; s++) {
+        script_name = names[s];
+        streams[s] = open_script (names[s], NULL, &script_maps[s]);
+        while ((command = read_command_stream (streams[s]))) {
+            if (travel_optimizing)
+                optimize_command (command);
+            last_node = append_command (last_node, command, &command_number);
         }
-        *words++;
+        ends[s] = command_number - 1;
     }
-    return 0;
+    add_all_dependencies (node_list);
+    return node_list;
 }
 
-void add_edge (graph_node *src, graph_node *dst) {
-    if (DEBUG) printf ("Adding edge from %i to %i\n", src->seq_no, dst->seq_no);
-    if (!src->out_edges) {
-        src->max_edge_count = WORDMIN;
-        src->out_edges = (graph_node **) checked_malloc (sizeof (graph_node *) * src->max_edge_count);
+// Sets each script's entry of last_commands to the command of its last
+// node, or NULL if it has none, given the seq_no of each one's last node
+void last_commands_of (graph_nodes *node_list, int *ends, command_t *last_commands) {
+    int s = 0;
+    for (; node_list && node_list->node; node_list = node_list->next) {
+        while (node_list->node->seq_no > ends[s])
+            s++;
+        last_commands[s] = node_list->node->command;
     }
-    src->out_edges[src->edge_count] = dst;
-    src->edge_count++;
-    if (src->edge_count == src->max_edge_count) {
-        size_t max_size = src->max_edge_count * sizeof (graph_node *);
-        src->out_edges = checked_grow_alloc (src->out_edges, &max_size);
-        src->max_edge_count = max_size / (sizeof (graph_node *));
-    }
-    src->out_edges[src->edge_count] = 0;
-    dst->in_edges++;
 }
 
-command_t execute_parallel (graph_nodes *node_list, int time_travel) {
-    command_t last_command = node_list->node->command;
-    graph_nodes *current_node = node_list;
-    child_node *children = NULL;
-    child_node *last_child = children;
-    pid_t child;
-    int status;
-
-    // Find disconnected graphs and separate into graphs
-    // Execute each graph separately (fork)
-    // Grandparent: wait for all graphs to complete
-    
-    while (node_list || children) {
-        // Parent: find nodes with no incoming edges and run separately (fork)
-        while (current_node) {
-            if (DEBUG) printf ("Pre-execution: %i (%i)\n", current_node->node->seq_no, current_node->node->in_edges);
-            if (current_node->node->in_edges == 0) {
-                child = fork();
-                if (child == 0) { // child
-                    if (DEBUG) printf ("Executing command %i... ", current_node->node->seq_no);
-                    execute_command (current_node->node->command, time_travel);
-                    if (DEBUG) printf ("complete [%i]\n", current_node->node->command->status);
-                    exit(current_node->node->command->status);
-                } else if (child > 0) { // parent
-                    // append new child process to children
-                    child_node *new_child = (child_node *) malloc (sizeof (child_node *));
-                    new_child->node = current_node->node;
-                    new_child->child = child;
-                    new_child->next = NULL;
-                    
-                    if (last_child)
-                        last_child->next = new_child;
-                    last_child = new_child;
-                    
-                    if (!children)
-                        children = last_child;
-                    
-                    // Prune from node_list
-                    if (DEBUG) printf ("Pruning %i from node list; ", current_node->node->seq_no);
-                    graph_nodes *executing_node = current_node;
-                    if (current_node == node_list) { // special case for if the completed node is first in nodelist
-                        if (DEBUG) printf ("moving node_list forward\n");
-                        node_list = node_list->next;
-                        if (node_list)
-                            node_list->prev = NULL;
-                        current_node = node_list;
-                    } else if (current_node->prev) {
-                        if (DEBUG) printf ("excising element\n");
-                        current_node->prev->next = current_node->next;
-                        current_node->next->prev = current_node->prev;
-                        current_node = current_node->next;
-                    }
-                    free (executing_node);
-                } else
-                    error (1, 0, "execute_parallel: failed to create child process!");
-            } else {
-                current_node = current_node->next;
-            }
-        }
-        
-        if (DEBUG) printf ("Traversed! ");
-        
-        // Parent waitpid for children
-        if (DEBUG) printf("\nWaiting for %i:%i to complete...", children->node->seq_no, children->child);
-        waitpid (children->child, &status, 0);
-        if (DEBUG) printf(" completed with status %i\n", status);
-        child_node *completed_child = children;
-        int complete = children->node->seq_no;
-        
-        // Parent: prune completed child nodes from nodelist; decrement in_edges
-        children = children->next;
-        decrement (completed_child->node);
-        if (!children)
-            last_child = NULL;
-        
-        last_command = completed_child->node->command;
-        free (completed_child->node);
-        free (completed_child);
-        current_node = node_list;
-        // TODO: (recursive) Find disconnected graphs, and execute separately
-    }
-    
-    
-    return last_command;
-}
+// The scheduler of travel_online while it reads, drained if reading exits,
+// and the process it belongs to
+static scheduler *online_sched;
+static pid_t online_pid;
 
-void decrement (graph_node *node) {
-    graph_node **out = node->out_edges;
-    while (out && *out) {
-        if (DEBUG) printf ("\nDecrementing from %i; ", (*out)->seq_no);
-        (*out)->in_edges--;
-        *out++;
-    }
+// Waits for the nodes travel_online has started when a syntax error in a
+// script exits, as the commands before it do sequentially.  Children
+// forked while it reads inherit the handler, and leave the nodes alone.
+static void
+drain_online (void)
+{
+    scheduler *sched = online_sched;
+    online_sched = NULL;
+    if (sched && getpid () == online_pid)
+        finish_scheduler (sched);
 }
 
-
-graph_nodes *append_command (graph_nodes *last_node, command_t command, int *command_number) {
-    // Split up top level sequence commands
-    while (command->type == SEQUENCE_COMMAND) {
-        if (command->type == SEQUENCE_COMMAND) {
-            last_node = append_command (last_node, command->u.command[0], command_number);
-            last_node = append_command (last_node, command->u.command[1], command_number);
-            free (command);
-            return last_node;
+// Reads the scripts named by names while their commands run with time
+// travel.  Each command joins the graph as soon as it is read, with edges
+// from the nodes before it that have not completed, and starts once those
+// have.  Keeps the streams in streams and the seq_no of the last node of
+// each script in ends, and returns the nodes, which have all completed.
+graph_nodes *travel_online (char **names, int count, command_stream_t *streams, int *ends, profile *prof, run_state *state) {
+    int command_number = 1;
+    command_t command;
+    graph_nodes *node_list = (graph_nodes *) checked_malloc (sizeof (graph_nodes));
+    graph_nodes *last_node = node_list, *n;
+    node_list->prev = NULL;
+    node_list->next = NULL;
+    node_list->node = NULL;
+    symbol_table symbols = { NULL, 0, 0, NULL, 0 };
+    scheduler sched;
+    start_scheduler (&sched, 1, travel_max_jobs, travel_jobserver_fd, prof, state, 1);
+    online_sched = &sched;
+    online_pid = getpid ();
+    atexit (drain_online);
+    online_script *online = (online_script *) checked_malloc (count * sizeof (online_script));
+    int s;
+    for (s = 0; s < count; s++) {
+        script_name = names[s];
+        online[s].sched = &sched;
+        streams[s] = open_script (names[s], &online[s], &script_maps[s]);
+        while ((command = read_command_stream (streams[s]))) {
+            if (travel_optimizing)
+                optimize_command (command);
+            n = last_node->node ? last_node : NULL;
+            last_node = append_command (last_node, command, &command_number);
+            for (n = n ? n->next : node_list; n; n = n->next) {
+                if (prof)
+                    n->node->profile_id = profile_id (prof, command_text (n->node->command));
+                if (state)
+                    n->node->state_id = state_id (state, command_text (n->node->command));
+                add_dependencies (&symbols, n->node);
+                schedule_node (&sched, n->node);
+            }
+            launch_ready (&sched);
         }
+        ends[s] = command_number - 1;
     }
-    // Parse and add to last_node
-    if (DEBUG) {
-        printf ("# %d\n", *command_number);
-        print_command (command);
-    }
-    
-    graph_node *n = parse_io (command, (*command_number)++);
-    if (last_node->node) {
-        last_node->next = (graph_nodes *) checked_malloc (sizeof (graph_nodes));
-        last_node->next->prev = last_node;
-        last_node = last_node->next;
-    }
-    last_node->node = n;
-    last_node->next = NULL;
-    return last_node;
+    online_sched = NULL;
+    finish_scheduler (&sched);
+    free_symbols (&symbols);
+    for (s = 0; s < count; s++)
+        if (online[s].fd >= 0)
+            close (online[s].fd);
+    free (online);
+    return node_list;
 }
-
@@ -0,0 +1,87 @@
+// UCLA CS 111 Lab 1 command optimization
+
+#include "command.h"
+#include "command-internals.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/* If C is a cat that only copies one file to its stdout, return the
+   file, else NULL.  That is "cat < FILE", or "cat FILE" where FILE does
+   not look like an option.  */
+static char *
+useless_cat (command_t c)
+{
+  if (c->type != SIMPLE_COMMAND || c->output || strcmp (c->u.word[0], "cat"))
+    return NULL;
+  char **w = c->u.word;
+  if (! w[1])
+    return c->input;
+  if (w[2] || c->input || w[1][0] == '-')
+    return NULL;
+  return w[1];
+}
+
+/* Return nonzero if C is a cat that copies its stdin to its stdout.  */
+static int
+plain_cat (command_t c)
+{
+  return c->type == SIMPLE_COMMAND && ! c->input && ! c->output
+    && ! strcmp (c->u.word[0], "cat") && ! c->u.word[1];
+}
+
+/* Return the first stage of the pipeline C.  */
+static command_t
+first_stage (command_t c)
+{
+  while (c->type == PIPE_COMMAND)
+    c = c->u.command[0];
+  return c;
+}
+
+void
+optimize_command (command_t c)
+{
+  switch (c->type)
+    {
+    case SIMPLE_COMMAND:
+      break;
+
+    case SUBSHELL_COMMAND:
+      optimize_command (c->u.subshell_command);
+      break;
+
+    case PIPE_COMMAND:
+      optimize_command (c->u.command[0]);
+      optimize_command (c->u.command[1]);
+
+      /* "A | cat | B" becomes "A | B", as A writes to a pipe either
+	 way.  Pipelines group to the left, so such a cat ends the left
+	 side of C.  A cat that ends the whole pipeline stays, since
+	 programs may behave differently when stdout is not a pipe.  */
+      while (c->u.command[0]->type == PIPE_COMMAND
+	     && plain_cat (c->u.command[0]->u.command[1]))
+	*c->u.command[0] = *c->u.command[0]->u.command[0];
+
+      for (;;)
+	{
+	  /* "cat FILE | A | B" becomes "A < FILE | B" when A has no
+	     input of its own; the pipe node takes over A's pipeline.
+	     The nodes dropped live on in the command's arena.  */
+	  if (c->type != PIPE_COMMAND)
+	    break;
+	  char *file = useless_cat (c->u.command[0]);
+	  command_t consumer = first_stage (c->u.command[1]);
+	  if (! file || consumer->type != SIMPLE_COMMAND || consumer->input)
+	    break;
+	  consumer->input = file;
+	  *c = *c->u.command[1];
+	}
+      break;
+
+    default:
+      optimize_command (c->u.command[0]);
+      optimize_command (c->u.command[1]);
+      break;
+    }
+}
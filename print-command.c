@@ -3,8 +3,11 @@
 #include "command.h"
 #include "command-internals.h"
 
+#include "alloc.h"
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void
 command_indented_print (int indent, command_t c)
@@ -56,3 +59,70 @@ print_command (command_t c)
   command_indented_print (2, c);
   putchar ('\n');
 }
+
+static void
+append_text (char const *text, char **buf, size_t *len, size_t *size)
+{
+  size_t n = strlen (text);
+  while (*len + n + 1 > *size)
+    *buf = checked_grow_alloc (*buf, size);
+  memcpy (*buf + *len, text, n);
+  *len += n;
+}
+
+static void
+append_command (command_t c, char **buf, size_t *len, size_t *size)
+{
+  static char const *const command_label[] = { " && ", " ; ", " || ", " | " };
+  char **w;
+  switch (c->type)
+    {
+    case AND_COMMAND:
+    case SEQUENCE_COMMAND:
+    case OR_COMMAND:
+    case PIPE_COMMAND:
+      append_command (c->u.command[0], buf, len, size);
+      append_text (command_label[c->type], buf, len, size);
+      append_command (c->u.command[1], buf, len, size);
+      break;
+
+    case SIMPLE_COMMAND:
+      for (w = c->u.word; *w; w++)
+	{
+	  if (w != c->u.word)
+	    append_text (" ", buf, len, size);
+	  append_text (*w, buf, len, size);
+	}
+      break;
+
+    case SUBSHELL_COMMAND:
+      append_text ("(", buf, len, size);
+      append_command (c->u.subshell_command, buf, len, size);
+      append_text (")", buf, len, size);
+      break;
+
+    default:
+      abort ();
+    }
+
+  if (c->input)
+    {
+      append_text ("<", buf, len, size);
+      append_text (c->input, buf, len, size);
+    }
+  if (c->output)
+    {
+      append_text (">", buf, len, size);
+      append_text (c->output, buf, len, size);
+    }
+}
+
+char *
+command_text (command_t c)
+{
+  size_t len = 0, size = 64;
+  char *buf = checked_malloc (size);
+  append_command (c, &buf, &len, &size);
+  buf[len] = 0;
+  return buf;
+}
@@ -7,24 +7,59 @@
 #include <error.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#if defined __GNUC__ && defined __SSE2__ && (defined __x86_64__ || defined __i386__)
+# include <immintrin.h>
+# define HAVE_AVX2_TARGET 1
+#endif
 #define DEBUG 0
 #define STRMIN 8
+#define NEED_BYTE (EOF - 1)
 
 
 // typedefs
+// returns the length of the run of word characters at the start of a buffer
+typedef size_t (*scan_function) (unsigned char const *, size_t);
+
 typedef struct command_node {
 	command_t command;
 	struct command_node *next;
 } command_node;
 
+// A command returned by read_command_stream.  The command and everything it
+// points to, apart from words sliced from a script buffer, live in arena.
+typedef struct parsed_command {
+	struct arena arena;
+	struct command_stream *stream;
+	struct parsed_command *prev;
+	struct parsed_command *next;
+	struct command command;
+} parsed_command;
+
+// Tokenizing state; one complete command is read per read_command_stream call
 typedef struct command_stream {
-	command_node *commands;
+	int (*get_next_byte) (void *); // NULL when reading from buf
+	void *get_next_byte_argument;
+	char *buf;
+	size_t len;
+	size_t pos;
+	scan_function scan_simple;
+	int c; // next unprocessed byte, NEED_BYTE if not yet read, or EOF
+	int line;
+	struct arena scratch; // tokens and parse stacks of the current command
+	struct arena *arena; // arena of the command tree being built
+	parsed_command *parsed; // commands read and not yet freed
+	char *word; // buffer for words read byte by byte
+	size_t max_word_size;
+	size_t token_count; // size of the current command, for sizing its arena
+	size_t word_bytes;
 } command_stream;
 
 typedef struct token {
     enum command_type type;
     int is_operator; // set to 0 for normal words
     char *word; // only populated for command_type = SIMPLE
+    int borrowed; // word points into the script buffer rather than scratch
     int line;
     struct token *next;
     struct token *prev;
@@ -39,39 +74,66 @@ typedef struct token_stream {
 /**** function declarations ****/
 
 // constructors
-command_stream_t init_command_stream ();
-command_node *init_command_node ();
-command_t init_command ();
+static command_stream_t init_command_stream ();
+static command_node *init_command_node (command_stream_t s);
+static command_t init_command (struct arena *a);
+static token *init_token (command_stream_t s, int line);
 
 // validation functions
-int valid_char (int c);
-int simple_char (int c);
-int operator_char (int c);
-int whitespace_char (int c);
+static int valid_char (int c);
+static int simple_char (int c);
+static int operator_char (int c);
+static int whitespace_char (int c);
+static scan_function choose_scan_simple (void);
 
 // returns numeric priority of command_type
-int precedence (enum command_type type);
+static int precedence (enum command_type type);
 
 // processing functions
-command_node *single_command (int (*get_next_byte) (void *), void *get_next_byte_argument, int subshell);
-void process_command (token **operators, command_node **commands, int prec, int *command_num, int *operator_num);
-command_node *parse_command (token_stream **ts, int subshell);
+static void process_command (command_stream_t s, token **operators, command_node **commands, int prec, int *command_num, int *operator_num);
+static command_node *parse_command (command_stream_t s, token_stream **ts, int subshell);
+token_stream *read_token_stream (command_stream_t s);
 
-int line = 1;
+static int line = 1;
 
 command_stream_t make_command_stream (int (*get_next_byte) (void *), void *get_next_byte_argument)
 {
-	// cs_head = first command in file
 	command_stream_t cs = init_command_stream ();
-	command_node *cn_last = cs->commands;
-    line = 1;
+	cs->get_next_byte = get_next_byte;
+	cs->get_next_byte_argument = get_next_byte_argument;
+	return cs;
+}
+
+command_stream_t make_command_stream_from_buffer (char *buf, size_t len)
+{
+	command_stream_t cs = init_command_stream ();
+	cs->buf = buf;
+	cs->len = len;
+	cs->scan_simple = choose_scan_simple ();
+	return cs;
+}
+
+// Returns the next input byte of s, or EOF
+static inline int next_byte (command_stream_t s)
+{
+    if (!s->get_next_byte)
+        return s->pos < s->len ? (unsigned char) s->buf[s->pos++] : EOF;
+    return s->get_next_byte (s->get_next_byte_argument);
+}
+
+// Tokenizes the next complete command from s and returns its token stream,
+// or NULL at EOF.  Stops right after the newline that ends the command, so
+// nothing past the current command is read from the input.
+token_stream *read_token_stream (command_stream_t s)
+{
+    if (s->c == EOF)
+        return NULL;
+    line = s->line;
     
     // token stream parsing
-    int c = get_next_byte(get_next_byte_argument);
+    int c = s->c == NEED_BYTE ? next_byte (s) : s->c;
     int next = 1, in_comment = 0, paren = 0;
-    token_stream *root_ts = NULL;
-    token_stream *last_ts = root_ts;
-    token_stream *current_ts = last_ts;
+    token_stream *current_ts = NULL;
     token *last_t = NULL;
     
     while (c != EOF) {
@@ -82,23 +144,15 @@ command_stream_t make_command_stream (int (*get_next_byte) (void *), void *get_n
         } else if (!current_ts) {
             if (DEBUG) printf("%i: New command\n", line);
             paren = 0;
-            current_ts = (token_stream *) checked_malloc (sizeof (token_stream));
+            current_ts = (token_stream *) arena_alloc (&s->scratch, sizeof (token_stream));
             current_ts->item = NULL;
             current_ts->next = NULL;
-            if (!root_ts)
-                root_ts = current_ts;
-            if (last_ts)
-                last_ts->next = current_ts;
-            last_ts = current_ts;
-            
             last_t = NULL;
         }
-        token *t = (token *) checked_malloc (sizeof (token));
-        t->next = NULL; t->prev = NULL;
-        t->line = line;
+        int t_line = line;
         
         if (c == '\n') {
-            // newline logic -- check whether to start new token stream
+            // newline logic -- check whether to end the token stream
             line++;
             in_comment = 0; // exit comment mode
             
@@ -108,34 +162,60 @@ command_stream_t make_command_stream (int (*get_next_byte) (void *), void *get_n
                     || !strcmp(last_t->word, ")"))) {
                 if (last_t->type == SEQUENCE_COMMAND) {
                     // pop off last operator if it's a semicolon
-                    if (DEBUG) printf("%i: Popping off semicolon prior to end of command\n", t->line);
-                    token *temp = last_t;
+                    if (DEBUG) printf("%i: Popping off semicolon prior to end of command\n", t_line);
                     last_t = last_t->prev;
                     last_t->next = NULL;
-                    free (temp);
                 }
-                current_ts = NULL;
+                // command complete; leave the rest of the input unread
+                s->c = NEED_BYTE;
+                s->line = line;
+                return current_ts;
             } else if (last_t && !last_t->is_operator && paren > 0) { // Interpret newline as semicolon if inside subshell
                 c = ';';
                 goto operator;
             } else if (last_t && last_t->is_operator && last_t->type == SIMPLE_COMMAND)
-                error (1, 0, "%i: Newline after redirect %s is not permitted\n", t->line, last_t->word);
+                error (1, 0, "%i: Newline after redirect %s is not permitted\n", t_line, last_t->word);
         } else if (in_comment || whitespace_char (c)) {
-            // do nothing
+            // do nothing; skip the rest of the run when reading from a buffer
+            if (!s->get_next_byte)
+                while (s->pos < s->len && whitespace_char ((unsigned char) s->buf[s->pos]))
+                    s->pos++;
         } else if (simple_char (c)) {
-            char *word = (char *) checked_malloc (sizeof (char) * STRMIN);
+            token *t = init_token (s, t_line);
+            char *word;
             size_t max_word_size = sizeof (char) * STRMIN;
-            int word_size = 0;
-            // build word
-            do {
-                word[word_size] = c;
-                word_size++;
-                if (word_size == (int) (max_word_size/sizeof (char))) { // expand word if necessary
-                    word = checked_grow_alloc (word, &max_word_size);
+            if (!s->get_next_byte) {
+                // slice the word out of the buffer, terminating it in place of
+                // the delimiter after it (which is kept in c)
+                size_t start = s->pos - 1;
+                s->pos += s->scan_simple ((unsigned char const *) s->buf + s->pos,
+                                          s->len - s->pos);
+                if (s->pos < s->len) {
+                    word = s->buf + start;
+                    c = (unsigned char) s->buf[s->pos];
+                    s->buf[s->pos++] = 0;
+                    t->borrowed = 1;
+                } else { // no delimiter to overwrite at the end of the buffer
+                    max_word_size = s->pos - start + 1;
+                    word = arena_strndup (&s->scratch, s->buf + start, max_word_size - 1);
+                    s->word_bytes += max_word_size;
+                    c = EOF;
                 }
-                c = get_next_byte (get_next_byte_argument);
-            } while (simple_char (c));
-            word[word_size] = 0;
+            } else {
+                int word_size = 0;
+                // build word
+                do {
+                    s->word[word_size] = c;
+                    word_size++;
+                    if (word_size == (int) (s->max_word_size/sizeof (char))) { // expand word if necessary
+                        s->word = checked_grow_alloc (s->word, &s->max_word_size);
+                    }
+                    c = next_byte (s);
+                } while (simple_char (c));
+                max_word_size = s->max_word_size;
+                word = arena_strndup (&s->scratch, s->word, word_size);
+                s->word_bytes += word_size + 1;
+            }
             next = 0; // already called next char
             
             t->type = SIMPLE_COMMAND;
@@ -156,15 +236,16 @@ command_stream_t make_command_stream (int (*get_next_byte) (void *), void *get_n
             // parse operator
         operator:
             if (DEBUG) printf("Operator %c\n", c);
+            token *t = init_token (s, t_line);
             enum command_type type;
-            char *word = (char *) checked_malloc (sizeof (char) * 1);
-            word[0] = c;
+            char op = c;
+            char *word = arena_strndup (&s->scratch, &op, 1);
             switch (c) {
                 case ';':
                     type = SEQUENCE_COMMAND;
                     break;
                 case '&':
-                    c = get_next_byte (get_next_byte_argument);
+                    c = next_byte (s);
                     if (c == '&')
                         type = AND_COMMAND;
                     else {
@@ -173,7 +254,7 @@ command_stream_t make_command_stream (int (*get_next_byte) (void *), void *get_n
                     break;
                     
                 case '|':
-                    c = get_next_byte (get_next_byte_argument);
+                    c = next_byte (s);
                     if (DEBUG) printf("Char after |: %c\t", c);
                     if (c == '|') {
                         type = OR_COMMAND;
@@ -195,10 +276,8 @@ command_stream_t make_command_stream (int (*get_next_byte) (void *), void *get_n
                     if (last_t && last_t->type == SEQUENCE_COMMAND) {
                         // pop off last operator if it's a semicolon
                         if (DEBUG) printf("%i: Popping off semicolon prior to )\n", t->line);
-                        token *temp = last_t;
                         last_t = last_t->prev;
                         last_t->next = NULL;
-                        free (temp);
                     }
                     break;
                     
@@ -231,61 +310,81 @@ command_stream_t make_command_stream (int (*get_next_byte) (void *), void *get_n
         } else if (c == '#') {
             // enter comment mode
             in_comment = 1;
+            if (!s->get_next_byte) { // skip straight to the newline
+                char *nl = memchr (s->buf + s->pos, '\n', s->len - s->pos);
+                s->pos = nl ? (size_t) (nl - s->buf) : s->len;
+            }
         }
         
         if (next)
-            c = get_next_byte(get_next_byte_argument);
+            c = next_byte (s);
         next = 1;
     }
+    s->c = EOF;
+    s->line = line;
     if (last_t && last_t->type == SEQUENCE_COMMAND) {
         // pop off last operator if it's a semicolon
         if (DEBUG) printf("%i: Popping off semicolon prior to EOF\n", last_t->line);
-        token *temp = last_t;
         last_t = last_t->prev;
         last_t->next = NULL;
-        free (temp);
-    }
-    
-    // command parsing
-    token_stream *ts = root_ts;
-    int i = 1;
-    while (ts && ts->item) {
-        if (DEBUG) printf("%i: \n", i);
-        
-		command_node *new_command = parse_command (&ts, 0);
-		if (!cs->commands && new_command) {
-			cs->commands = new_command;
-			cn_last = new_command;
-		} else if (new_command && cn_last) {
-			cn_last->next = new_command;
-			cn_last = new_command;
-		}
-        
-        if (DEBUG) printf("New separate command added %i\n", i);
-        token_stream *o_ts = ts;
-        ts = ts->next;
-        free (o_ts);
-        i++;
     }
-
-	if (DEBUG) printf ("EOF\n");
-	return cs;
+    return current_ts;
 }
 
 command_t read_command_stream (command_stream_t s)
 {
 	command_t c = NULL;
-	if (s->commands) {
-		if (DEBUG) printf("%p\n", s->commands);
-		c = s->commands->command;
-		command_node *old = s->commands;
-		s->commands = s->commands->next;
-		free (old);
+	arena_reset (&s->scratch);
+	s->token_count = 0;
+	s->word_bytes = 0;
+	token_stream *ts = read_token_stream (s);
+	if (ts && ts->item) {
+		if (DEBUG) printf("%i: \n", s->line);
+		// Size the first chunk to fit the whole tree: each token yields at
+		// most one command and two word pointers
+		struct arena a;
+		arena_init (&a, sizeof (parsed_command) + s->word_bytes
+				+ s->token_count * (sizeof (struct command) + 4 * sizeof (char *)));
+		parsed_command *pc = (parsed_command *) arena_alloc (&a, sizeof (parsed_command));
+		pc->arena = a;
+		s->arena = &pc->arena;
+
+		command_node *cn = parse_command (s, &ts, 0);
+		pc->command = *cn->command;
+		pc->stream = s;
+		pc->prev = NULL;
+		pc->next = s->parsed;
+		if (s->parsed)
+			s->parsed->prev = pc;
+		s->parsed = pc;
+		c = &pc->command;
 	}
 	return c;
 }
 
-command_node *parse_command (token_stream **ts, int subshell) {
+void free_command (command_t c)
+{
+	parsed_command *pc = (parsed_command *) ((char *) c - offsetof (parsed_command, command));
+	if (pc->prev)
+		pc->prev->next = pc->next;
+	else
+		pc->stream->parsed = pc->next;
+	if (pc->next)
+		pc->next->prev = pc->prev;
+	struct arena a = pc->arena; // pc itself lives in the arena
+	arena_free (&a);
+}
+
+void free_command_stream (command_stream_t s)
+{
+	while (s->parsed)
+		free_command (&s->parsed->command);
+	arena_free (&s->scratch);
+	free (s->word);
+	free (s);
+}
+
+static command_node *parse_command (command_stream_t s, token_stream **ts, int subshell) {
     if (DEBUG && subshell) printf("Entering parse_command for subshell\n");
 	command_node *commands = NULL; int command_num = 0; // command stack + counter
 	token *operators = NULL; int operator_num = 0; // operator stack + counter
@@ -295,27 +394,25 @@ command_node *parse_command (token_stream **ts, int subshell) {
     while (t) {
         if (DEBUG) printf("Processing token %s\n", t->word);
         if (t->is_operator) {
-            token *current_op = (token *) malloc (sizeof (token));
+            token *current_op = (token *) arena_alloc (&s->scratch, sizeof (token));
             *current_op = *t;
             
             // process stacks if precedence is lower/equal than top of stack
             if (t->type == SUBSHELL_COMMAND) { // special case for SUBSHELL_COMMAND
                 if (DEBUG) printf ("Processing subshell command %s\n", t->word);
                 if (!strcmp(t->word, "(")) {
-                    command_node *subshell_cn = init_command_node ();
+                    command_node *subshell_cn = init_command_node (s);
                     subshell_cn->command->type = SUBSHELL_COMMAND;
                     
-                    token_stream *sub_ts = (token_stream *) checked_malloc (sizeof (token_stream));
+                    token_stream *sub_ts = (token_stream *) arena_alloc (&s->scratch, sizeof (token_stream));
                     sub_ts->next = NULL;
                     sub_ts->item = t->next;
                     
-                    command_node *child = parse_command (&sub_ts, 1);
+                    command_node *child = parse_command (s, &sub_ts, 1);
                     t = sub_ts->item;
                     if (DEBUG) printf("After subshell, setting item to %s\n", t->word);
                     
                     subshell_cn->command->u.subshell_command = child->command;
-                    free (child);
-                    free (sub_ts);
                     
                     subshell_cn->next = commands; command_num++;
                     commands = subshell_cn;
@@ -325,7 +422,7 @@ command_node *parse_command (token_stream **ts, int subshell) {
                         error (1, 0, "%i: encountered unexpected subshell close\n", t->line);
                     else {
                         if (operator_num + 1 == command_num)
-                            process_command (&operators, &commands, 10, &command_num, &operator_num); // TODO: 10?
+                            process_command (s, &operators, &commands, 10, &command_num, &operator_num); // TODO: 10?
                         else {
                             error (1, 0, "%i: Incomplete command inside subshell\t %i operators, %i commands\n", t->line, operator_num, command_num);
                         }
@@ -345,7 +442,7 @@ command_node *parse_command (token_stream **ts, int subshell) {
                 operators = current_op;
             } else {
                 if (DEBUG) printf("Lower or equal precedence operator encountered\t %i commands %i operators\n", command_num, operator_num);
-                process_command (&operators, &commands, precedence (t->type), &command_num, &operator_num);
+                process_command (s, &operators, &commands, precedence (t->type), &command_num, &operator_num);
                 // push onto operators stack
                 current_op->next = operators; operator_num++;
                 operators = current_op;
@@ -355,7 +452,7 @@ command_node *parse_command (token_stream **ts, int subshell) {
         } else {
             // build char ** word list
             // build SIMPLE_COMMAND and push to top of stack
-            command_node *simple_cn = init_command_node ();
+            command_node *simple_cn = init_command_node (s);
             simple_cn->command->type = SIMPLE_COMMAND;
             token *word = t;
             int word_count = 0;
@@ -366,10 +463,11 @@ command_node *parse_command (token_stream **ts, int subshell) {
             }
             
             if (DEBUG) printf("allocating %i words \n", word_count);
-            simple_cn->command->u.word = (char **) checked_malloc (sizeof (char *) * (word_count + 1));
+            simple_cn->command->u.word = (char **) arena_alloc (s->arena, sizeof (char *) * (word_count + 1));
             int i = 0;
             while (i < word_count) {
-                simple_cn->command->u.word[i] = t->word;
+                simple_cn->command->u.word[i] = t->borrowed ? t->word
+                    : arena_strndup (s->arena, t->word, strlen (t->word));
                 i++;
                 if (i < word_count)
                     t = t->next;
@@ -381,15 +479,13 @@ command_node *parse_command (token_stream **ts, int subshell) {
             simple_cn->next = commands; command_num++;
             commands = simple_cn;
         }
-        token *old = t;
+        line = t->line;
         t = t->next;
-        line = old->line;
-        free (old);
 
         if (DEBUG) printf("Processed token: command_num %i; operator_num %i\n", command_num, operator_num);
     }
     // process stacks
-	process_command (&operators, &commands, 10, &command_num, &operator_num);
+	process_command (s, &operators, &commands, 10, &command_num, &operator_num);
 
 	if (command_num != 1 || operator_num != 0)
 		error (1, 0, "%i: Incomplete command at end of file\n", line);
@@ -398,27 +494,52 @@ command_node *parse_command (token_stream **ts, int subshell) {
     return commands;
 }
 
-command_stream_t init_command_stream () {
+static command_stream_t init_command_stream () {
 	command_stream_t cs = (command_stream_t) checked_malloc (sizeof (command_stream));
-	cs->commands = 0;
+	cs->get_next_byte = NULL;
+	cs->get_next_byte_argument = NULL;
+	cs->buf = NULL;
+	cs->len = 0;
+	cs->pos = 0;
+	cs->scan_simple = NULL;
+	cs->c = NEED_BYTE;
+	cs->line = 1;
+	arena_init (&cs->scratch, 4096);
+	cs->arena = NULL;
+	cs->parsed = NULL;
+	cs->max_word_size = sizeof (char) * STRMIN;
+	cs->word = (char *) checked_malloc (cs->max_word_size);
+	cs->token_count = 0;
+	cs->word_bytes = 0;
 	return cs;
 }
 
-command_node *init_command_node () {
-	command_node *c = (command_node *) checked_malloc (sizeof (command_node));
+static command_node *init_command_node (command_stream_t s) {
+	command_node *c = (command_node *) arena_alloc (&s->scratch, sizeof (command_node));
 	c->next = NULL;
-	c->command = init_command ();
+	c->command = init_command (s->arena);
 	return c;
 }
 
-command_t init_command () {
-	command_t c = (command_t) checked_malloc (sizeof (struct command));
+static command_t init_command (struct arena *a) {
+	command_t c = (command_t) arena_alloc (a, sizeof (struct command));
+	c->status = -1;
 	c->input = 0;
 	c->output = 0;
 	return c;
 }
 
-void process_command (token **operators, command_node **commands, int prec, int *command_num, int *operator_num) {
+static token *init_token (command_stream_t s, int line) {
+	token *t = (token *) arena_alloc (&s->scratch, sizeof (token));
+	t->next = NULL; t->prev = NULL;
+	t->word = NULL;
+	t->borrowed = 0;
+	t->line = line;
+	s->token_count++;
+	return t;
+}
+
+static void process_command (command_stream_t s, token **operators, command_node **commands, int prec, int *command_num, int *operator_num) {
 	if (DEBUG) printf("process_command %i;\t command_num %i; operator_num %i\n", prec, *command_num, *operator_num);
 	command_node *cn_current = NULL;
 	token *op_current = *operators;
@@ -442,7 +563,6 @@ void process_command (token **operators, command_node **commands, int prec, int
                 if ((*commands)->command->output) {// TODO: Check? works in bash
                     char *temp = (*commands)->command->output;
                     if (DEBUG) printf("%i: Disposing of prior input %s\n", op_current->line, temp);
-                    free (temp);
                     // error (1, 0, "%i: multiple output redirects in a row\n", op_current->line);
                 }
 				(*commands)->command->output = *w;
@@ -453,7 +573,6 @@ void process_command (token **operators, command_node **commands, int prec, int
                 if ((*commands)->command->input) {
                     char *temp = (*commands)->command->input;
                     if (DEBUG) printf("%i: Disposing of prior input %s\n", op_current->line, temp);
-                    free (temp);
                     // error (1, 0, "%i: multiple input redirects in a row\n", op_current->line);
                 }
 				(*commands)->command->input = *w;
@@ -463,9 +582,8 @@ void process_command (token **operators, command_node **commands, int prec, int
             if (DEBUG) printf("Used word %s\n", *w);
 			if (*++w) // Check that there is only 1 word in cn_current
 				error (1, 0, "%i: run-on word after redirection [%s]\n", op_current->line, *w);
-			free (cn_current);
 		} else { // create bifurcated command from top of operator stack
-			command_node *tree_command = init_command_node ();
+			command_node *tree_command = init_command_node (s);
 			if (!(*commands)) error (1, 0, "%i: missing arguments to bifurcated command %s\n", op_current->line, op_current->word);
 			tree_command->command->u.command[1] = (*commands)->command;
 			*commands = (*commands)->next; (*command_num)--;
@@ -479,60 +597,138 @@ void process_command (token **operators, command_node **commands, int prec, int
 			*commands = tree_command; (*command_num)++;
 		}
 		*operators = (*operators)->next; (*operator_num)--;
-		free (op_current);
 		op_current = *operators;
 	}
 	if (DEBUG) printf("After processing: command_num %i; operator_num %i\n", *command_num, *operator_num);
 }
 
-int valid_char (int c) {
-	if (simple_char (c) ||
-			(c == '#') ||
-			(c == '\n') ||
-			operator_char (c) ||
-			whitespace_char (c) 
-	) return 1;
-	return 0;
+// Character classes, indexed by byte value
+#define CHAR_SIMPLE 1
+#define CHAR_OPERATOR 2
+#define CHAR_WHITESPACE 4
+#define CHAR_OTHER 8 // '#' and newline
+
+static unsigned char const char_class[UCHAR_MAX + 1] = {
+	['0' ... '9'] = CHAR_SIMPLE,
+	['A' ... 'Z'] = CHAR_SIMPLE,
+	['a' ... 'z'] = CHAR_SIMPLE,
+	['!'] = CHAR_SIMPLE, ['%'] = CHAR_SIMPLE, ['+'] = CHAR_SIMPLE,
+	[','] = CHAR_SIMPLE, ['-'] = CHAR_SIMPLE, ['.'] = CHAR_SIMPLE,
+	['/'] = CHAR_SIMPLE, [':'] = CHAR_SIMPLE, ['@'] = CHAR_SIMPLE,
+	['^'] = CHAR_SIMPLE, ['_'] = CHAR_SIMPLE,
+	[';'] = CHAR_OPERATOR, ['&'] = CHAR_OPERATOR, ['|'] = CHAR_OPERATOR,
+	['('] = CHAR_OPERATOR, [')'] = CHAR_OPERATOR, ['<'] = CHAR_OPERATOR,
+	['>'] = CHAR_OPERATOR,
+	[' '] = CHAR_WHITESPACE, ['\t'] = CHAR_WHITESPACE,
+	['#'] = CHAR_OTHER, ['\n'] = CHAR_OTHER,
+};
+
+// c may also be EOF
+#define CHAR_CLASS(c) ((unsigned) (c) <= UCHAR_MAX ? char_class[c] : 0)
+
+static int valid_char (int c) {
+	return CHAR_CLASS (c) != 0;
 }
 
-int simple_char (int c) {
-	if ((c >= '0' && c <= '9') ||
-			(c >= 'A' && c <= 'Z') ||
-			(c >= 'a' && c <= 'z') ||
-			(c == '!') ||
-			(c == '%') ||
-			(c == '+') ||
-			(c == ',') ||
-			(c == '-') || 
-			(c == '.') ||
-			(c == '/') ||
-			(c == ':') || 
-			(c == '@') || 
-			(c == '^') ||
-			(c == '_')
-	) return 1;
-	return 0;
+static int simple_char (int c) {
+	return CHAR_CLASS (c) & CHAR_SIMPLE;
 }
 
-int operator_char (int c) {
-	if ((c == ';') ||
-			(c == '&') ||
-			(c == '|') ||
-			(c == '(') ||
-			(c == ')') ||
-			(c == '<') ||
-			(c == '>'))
-		return 1;
-	return 0;
+static int operator_char (int c) {
+	return CHAR_CLASS (c) & CHAR_OPERATOR;
 }
 
-int whitespace_char (int c) { // inline only
-	if ((c == ' ') || (c == '\t'))
-		return 1;
-	return 0;
+static int whitespace_char (int c) { // inline only
+	return CHAR_CLASS (c) & CHAR_WHITESPACE;
+}
+
+/* Word scanning kernels: each returns the length of the run of simple_char
+   bytes at the start of the N bytes at P.  The vector versions test 16 or
+   32 bytes per step against the ranges that make up simple_char:
+   '!', '%', '+' through ':', '@' through 'Z', '^' '_', and 'a' through 'z'.
+   Bytes above 0x7f compare as negative and so fall outside every range.
+   Only words are scanned this way: runs of whitespace are short, operators
+   are one or two bytes, and comments reach their newline with memchr,
+   which the C library vectorizes already.  */
+
+static size_t scan_simple_scalar (unsigned char const *p, size_t n) {
+	size_t i = 0;
+	while (i < n && (char_class[p[i]] & CHAR_SIMPLE))
+		i++;
+	return i;
+}
+
+#ifdef __SSE2__
+static inline __m128i in_range_sse2 (__m128i x, char lo, char hi) {
+	return _mm_and_si128 (_mm_cmpgt_epi8 (x, _mm_set1_epi8 (lo - 1)),
+			_mm_cmpgt_epi8 (_mm_set1_epi8 (hi + 1), x));
+}
+
+static size_t scan_simple_sse2 (unsigned char const *p, size_t n) {
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128 ((__m128i const *) (p + i));
+		__m128i m = _mm_or_si128 (
+				_mm_or_si128 (_mm_cmpeq_epi8 (x, _mm_set1_epi8 ('!')),
+					_mm_cmpeq_epi8 (x, _mm_set1_epi8 ('%'))),
+				_mm_or_si128 (
+					_mm_or_si128 (in_range_sse2 (x, '+', ':'),
+						in_range_sse2 (x, '@', 'Z')),
+					_mm_or_si128 (in_range_sse2 (x, '^', '_'),
+						in_range_sse2 (x, 'a', 'z'))));
+		unsigned mask = _mm_movemask_epi8 (m);
+		if (mask != 0xffff)
+			return i + __builtin_ctz (~mask);
+	}
+	return i + scan_simple_scalar (p + i, n - i);
+}
+#endif
+
+#ifdef HAVE_AVX2_TARGET
+__attribute__ ((target ("avx2")))
+static inline __m256i in_range_avx2 (__m256i x, char lo, char hi) {
+	return _mm256_and_si256 (_mm256_cmpgt_epi8 (x, _mm256_set1_epi8 (lo - 1)),
+			_mm256_cmpgt_epi8 (_mm256_set1_epi8 (hi + 1), x));
+}
+
+__attribute__ ((target ("avx2")))
+static size_t scan_simple_avx2 (unsigned char const *p, size_t n) {
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256 ((__m256i const *) (p + i));
+		__m256i m = _mm256_or_si256 (
+				_mm256_or_si256 (_mm256_cmpeq_epi8 (x, _mm256_set1_epi8 ('!')),
+					_mm256_cmpeq_epi8 (x, _mm256_set1_epi8 ('%'))),
+				_mm256_or_si256 (
+					_mm256_or_si256 (in_range_avx2 (x, '+', ':'),
+						in_range_avx2 (x, '@', 'Z')),
+					_mm256_or_si256 (in_range_avx2 (x, '^', '_'),
+						in_range_avx2 (x, 'a', 'z'))));
+		unsigned mask = _mm256_movemask_epi8 (m);
+		if (mask != 0xffffffff)
+			return i + __builtin_ctz (~mask);
+	}
+	return i + scan_simple_sse2 (p + i, n - i);
+}
+#endif
+
+// Picks the fastest kernel this CPU supports.  TIMETRASH_SCAN=scalar, sse2
+// or avx2 forces one, so that the kernels can be checked against each other.
+static scan_function choose_scan_simple (void) {
+	char const *force = getenv ("TIMETRASH_SCAN");
+	if (force && !strcmp (force, "scalar"))
+		return scan_simple_scalar;
+#ifdef HAVE_AVX2_TARGET
+	if (force ? !strcmp (force, "avx2") : __builtin_cpu_supports ("avx2"))
+		return scan_simple_avx2;
+#endif
+#ifdef __SSE2__
+	return scan_simple_sse2;
+#endif
+	return scan_simple_scalar;
 }
 
-int precedence (enum command_type type) {
+static int precedence (enum command_type type) {
 	switch (type) {
 		case AND_COMMAND:         // A && B
 			return 4;
@@ -0,0 +1,558 @@
+// UCLA CS 111 Lab 1 read/write signatures of common programs
+
+#include "signature.h"
+#include "alloc.h"
+
+#include <errno.h>
+#include <error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A signature file has one line per program:
+
+     PROGRAM SPEC...
+
+   where each SPEC is either an option or an operand role, and # starts
+   a comment.  A ROLE is r (the file is read), w (written), rw, or empty
+   or - (not a file).
+
+     -X:ROLE   option -X takes an argument, attached or in the next word
+     --XX:ROLE the same for a long option, attached with =
+     -X:ROLE*  the same, and when it is given every operand has the
+               starred role, as with cp -t DIR or grep -e PATTERN
+     -X        option -X swallows the rest of its word, e.g. gcc's -W
+     ROLE      the next operand has ROLE
+     ROLE*     any number of operands have ROLE
+     !cc       the program also writes what a C compiler does when not
+               told where: with -c or -S each source operand's base name
+               with .o or .s (and .d with -MD or -MMD but no -MF), and
+               without -c, -S, -E, -M or -MM, a.out
+
+   Operand roles before the starred one apply from the first operand,
+   those after it from the last.  Unlisted options take no argument, and
+   a word of single-letter options is scanned until one takes an
+   argument.  Operands beyond those described are assumed read and
+   written.  */
+
+#define CC_SIGNATURE \
+  " -o:w -MF:w -MT: -MQ: -MD -MMD -MP -MG -MM -include:r -imacros:r" \
+  " -isystem: -iquote: -idirafter: -isysroot: -iprefix: -iwithprefix:" \
+  " -iwithprefixbefore: -imultilib: -Xlinker: -Xassembler: -Xpreprocessor:" \
+  " -aux-info:w -dumpbase: -dumpdir: -coverage -pedantic -traditional" \
+  " -symbolic -I: -L: -l: -D: -U: -x: -W -f -m -O -g -no -std -print r* !cc\n"
+
+static char const builtin_signatures[] =
+  ": -*\n"
+  "true -*\n"
+  "false -*\n"
+  "echo -*\n"
+  "printf -*\n"
+  "sleep -*\n"
+  "seq -f: -s: -*\n"
+  "tr -*\n"
+  "cat r*\n"
+  "head -n: -c: r*\n"
+  "tail -n: -c: -s: r*\n"
+  "wc r*\n"
+  "cmp r*\n"
+  "diff r*\n"
+  "cut -b: -c: -d: -f: r*\n"
+  "grep -e:* -f:r* -m: -A: -B: -C: --regexp:* --file:r* - r*\n"
+  "sort -o:w --output:w -k: --key: -t: --field-separator: -S: -T: r*\n"
+  "uniq -f: -s: -w: r w\n"
+  "cp -t:w* --target-directory:w* -S: --suffix: r* w\n"
+  "ln -t:w* --target-directory:w* -S: --suffix: r* w\n"
+  "mv -t:w* --target-directory:w* -S: --suffix: rw* w\n"
+  "rm w*\n"
+  "rmdir w*\n"
+  "mkdir -m: --mode: w*\n"
+  "touch -r:r --reference:r -d: --date: -t: w*\n"
+  "chmod --reference:r w*\n"
+  "gzip -S: rw*\n"
+  "gunzip -S: rw*\n"
+  "tar -f:rw --file:rw -C: --directory: -T:r --files-from:r rw*\n"
+  "ar - rw r*\n"
+  "cc" CC_SIGNATURE
+  "gcc" CC_SIGNATURE
+  "c++" CC_SIGNATURE
+  "g++" CC_SIGNATURE
+  "clang" CC_SIGNATURE;
+
+struct option_signature
+{
+  char const *name;
+  size_t len;
+  int takes_arg;
+  int role;
+  int all_starred; // when given, every operand has the starred role
+};
+
+struct signature
+{
+  char const *program;
+  struct option_signature *options;
+  size_t option_count;
+  int *operands;
+  size_t operand_count;
+  size_t star; // index of the repeated operand role, or operand_count
+  int compiler; // has the implicit outputs of a C compiler
+};
+
+// Later signatures override earlier ones for the same program
+static struct signature *signatures;
+static size_t signature_count;
+static size_t max_signatures_size;
+static int builtins_loaded;
+
+// Set *ROLE from the role named by S.  Return 0 if S is not a role.
+static int
+parse_role (char const *s, int *role)
+{
+  if (! *s || ! strcmp (s, "-"))
+    *role = 0;
+  else if (! strcmp (s, "r"))
+    *role = SIG_READ;
+  else if (! strcmp (s, "w"))
+    *role = SIG_WRITE;
+  else if (! strcmp (s, "rw") || ! strcmp (s, "wr"))
+    *role = SIG_READ | SIG_WRITE;
+  else
+    return 0;
+  return 1;
+}
+
+// Add the signatures in TEXT, which is modified and must outlive them
+static void
+parse_signatures (char *text, char const *file)
+{
+  int line_number = 0;
+  char *line, *next;
+  for (line = text; line; line = next)
+    {
+      line_number++;
+      next = strchr (line, '\n');
+      if (next)
+        *next++ = 0;
+      line[strcspn (line, "#")] = 0;
+
+      char *token[64];
+      size_t count = 0;
+      char *p = line;
+      for (;;)
+        {
+          p += strspn (p, " \t\r");
+          if (! *p)
+            break;
+          if (count == sizeof token / sizeof *token)
+            error (1, 0, "%s:%d: too many fields", file, line_number);
+          token[count++] = p;
+          p += strcspn (p, " \t\r");
+          if (*p)
+            *p++ = 0;
+        }
+      if (! count)
+        continue;
+
+      struct signature sig;
+      sig.program = token[0];
+      sig.options = checked_malloc (count * sizeof *sig.options);
+      sig.option_count = 0;
+      sig.operands = checked_malloc (count * sizeof *sig.operands);
+      sig.operand_count = 0;
+      sig.star = count;
+      sig.compiler = 0;
+
+      size_t i;
+      for (i = 1; i < count; i++)
+        {
+          char *t = token[i];
+          size_t len = strlen (t);
+          int ok;
+          if (! strcmp (t, "!cc"))
+            ok = sig.compiler = 1;
+          else if (t[0] == '-' && t[1] && t[1] != '*')
+            {
+              struct option_signature *o = &sig.options[sig.option_count++];
+              char *colon = strchr (t, ':');
+              o->name = t;
+              o->takes_arg = colon != NULL;
+              o->role = 0;
+              o->all_starred = colon && t[len - 1] == '*';
+              ok = 1;
+              if (colon)
+                {
+                  *colon = 0;
+                  if (o->all_starred)
+                    t[len - 1] = 0;
+                  ok = parse_role (colon + 1, &o->role);
+                }
+              o->len = strlen (t);
+            }
+          else
+            {
+              if (t[len - 1] == '*')
+                {
+                  ok = sig.star == count;
+                  sig.star = sig.operand_count;
+                  t[len - 1] = 0;
+                }
+              else
+                ok = 1;
+              ok = ok && parse_role (t, &sig.operands[sig.operand_count++]);
+            }
+          if (! ok)
+            error (1, 0, "%s:%d: bad signature field '%s'", file, line_number,
+                   token[i]);
+        }
+      if (sig.star == count)
+        sig.star = sig.operand_count;
+
+      if ((signature_count + 1) * sizeof *signatures > max_signatures_size)
+        {
+          if (! max_signatures_size)
+            max_signatures_size = 32 * sizeof *signatures;
+          signatures = checked_grow_alloc (signatures, &max_signatures_size);
+        }
+      signatures[signature_count++] = sig;
+    }
+}
+
+/* A hash of the text of every signature loaded, in order.  */
+static unsigned long long digest = 14695981039346656037ull;
+
+static void
+add_to_digest (char const *text)
+{
+  for (; *text; text++)
+    digest = (digest ^ (unsigned char) *text) * 1099511628211ull; // FNV-1a
+  digest = (digest ^ 0xff) * 1099511628211ull;
+}
+
+static void
+load_builtin_signatures (void)
+{
+  if (builtins_loaded)
+    return;
+  builtins_loaded = 1;
+  char *text = checked_malloc (sizeof builtin_signatures);
+  memcpy (text, builtin_signatures, sizeof builtin_signatures);
+  add_to_digest (text);
+  parse_signatures (text, "built-in signatures");
+}
+
+void
+load_signatures (char const *file)
+{
+  load_builtin_signatures ();
+
+  FILE *f = fopen (file, "r");
+  if (! f)
+    error (1, errno, "%s: cannot open", file);
+  size_t size = 1024, len = 0, n;
+  char *text = checked_malloc (size);
+  while ((n = fread (text + len, 1, size - len - 1, f)) > 0)
+    if ((len += n) == size - 1)
+      text = checked_grow_alloc (text, &size);
+  if (ferror (f))
+    error (1, errno, "%s: read error", file);
+  fclose (f);
+  text[len] = 0;
+  add_to_digest (text);
+  parse_signatures (text, file);
+}
+
+unsigned long long
+signature_digest (void)
+{
+  load_builtin_signatures ();
+  return digest;
+}
+
+static struct signature const *
+find_signature (char const *program)
+{
+  char const *base = strrchr (program, '/');
+  base = base ? base + 1 : program;
+  size_t i;
+  for (i = signature_count; i-- > 0; )
+    if (! strcmp (signatures[i].program, base))
+      return &signatures[i];
+  return NULL;
+}
+
+// Return the option of SIG named by the LEN bytes at NAME, if any
+static struct option_signature const *
+find_option (struct signature const *sig, char const *name, size_t len)
+{
+  size_t i;
+  for (i = 0; i < sig->option_count; i++)
+    if (sig->options[i].len == len && ! memcmp (sig->options[i].name, name, len))
+      return &sig->options[i];
+  return NULL;
+}
+
+// Return the longest single-dash option of SIG with more than one letter
+// that is a prefix of ARG, if any
+static struct option_signature const *
+find_word_option (struct signature const *sig, char const *arg)
+{
+  struct option_signature const *best = NULL;
+  size_t i;
+  for (i = 0; i < sig->option_count; i++)
+    {
+      struct option_signature const *o = &sig->options[i];
+      if (o->len > 2 && o->name[1] != '-'
+          && ! strncmp (o->name, arg, o->len) && (! best || o->len > best->len))
+        best = o;
+    }
+  return best;
+}
+
+/* What the options of a C compiler say about the files it writes when
+   not told where.  */
+enum
+{
+  CC_COMPILE = 1,     // -c
+  CC_ASSEMBLE = 2,    // -S
+  CC_PREPROCESS = 4,  // -E, -M or -MM: nothing but what -o names
+  CC_DEPEND = 8,      // -MD or -MMD
+  CC_DEPEND_FILE = 16 // -MF
+};
+
+static int
+compiler_mode (char const *option)
+{
+  static struct
+  {
+    char const *name;
+    int mode;
+  } const modes[] = {
+    { "-c", CC_COMPILE }, { "-S", CC_ASSEMBLE }, { "-E", CC_PREPROCESS },
+    { "-M", CC_PREPROCESS }, { "-MM", CC_PREPROCESS }, { "-MD", CC_DEPEND },
+    { "-MMD", CC_DEPEND },
+  };
+  size_t i;
+  for (i = 0; i < sizeof modes / sizeof *modes; i++)
+    if (! strcmp (option, modes[i].name))
+      return modes[i].mode;
+  return 0;
+}
+
+/* Implied output names, which live as long as the commands that imply
+   them: an open-addressed set whose capacity is a power of 2.  */
+static char **implied_names;
+static size_t implied_count;
+static size_t implied_capacity;
+
+static size_t
+hash_bytes (size_t h, char const *s, size_t len)
+{
+  for (; len; s++, len--)
+    h = (h ^ (unsigned char) *s) * 16777619u; // FNV-1a
+  return h;
+}
+
+// Return the one copy of the LEN bytes at STEM followed by SUFFIX
+static char *
+implied_name (char const *stem, size_t len, char const *suffix)
+{
+  size_t suffix_len = strlen (suffix), i;
+  if (2 * (implied_count + 1) > implied_capacity)
+    {
+      size_t old_capacity = implied_capacity;
+      char **old = implied_names;
+      implied_capacity = old_capacity ? 2 * old_capacity : 64;
+      implied_names = checked_malloc (implied_capacity * sizeof *implied_names);
+      memset (implied_names, 0, implied_capacity * sizeof *implied_names);
+      for (i = 0; i < old_capacity; i++)
+        if (old[i])
+          {
+            size_t j = hash_bytes (2166136261u, old[i], strlen (old[i]));
+            for (j &= implied_capacity - 1; implied_names[j];
+                 j = (j + 1) & (implied_capacity - 1))
+              continue;
+            implied_names[j] = old[i];
+          }
+      free (old);
+    }
+
+  size_t h = hash_bytes (hash_bytes (2166136261u, stem, len), suffix, suffix_len);
+  for (i = h & (implied_capacity - 1); implied_names[i];
+       i = (i + 1) & (implied_capacity - 1))
+    if (! strncmp (implied_names[i], stem, len)
+        && ! strcmp (implied_names[i] + len, suffix))
+      return implied_names[i];
+  char *name = checked_malloc (len + suffix_len + 1);
+  memcpy (name, stem, len);
+  memcpy (name + len, suffix, suffix_len + 1);
+  implied_count++;
+  return implied_names[i] = name;
+}
+
+// Return the length of FILE without its suffix, if it has one
+static size_t
+stem_length (char const *file)
+{
+  char const *slash = strrchr (file, '/');
+  char const *dot = strrchr (slash ? slash + 1 : file, '.');
+  return dot && dot != (slash ? slash + 1 : file) ? (size_t) (dot - file)
+    : strlen (file);
+}
+
+// Return nonzero if a C compiler compiles or assembles FILE
+static int
+source_file (char const *file)
+{
+  static char const *const suffixes[] = {
+    ".c", ".i", ".cc", ".cp", ".cpp", ".cxx", ".c++", ".C", ".ii", ".m",
+    ".s", ".S", ".sx",
+  };
+  char const *suffix = file + stem_length (file);
+  size_t i;
+  for (i = 0; *suffix && i < sizeof suffixes / sizeof *suffixes; i++)
+    if (! strcmp (suffix, suffixes[i]))
+      return 1;
+  return 0;
+}
+
+// Report to FOUND the files a C compiler run in MODE on OPERANDS writes
+// besides OUTPUT, the argument of -o if there is one
+static void
+compiler_outputs (int mode, char *output, char **operands,
+                  size_t operand_count,
+                  void (*found) (void *, char *, int), void *arg)
+{
+  if (mode & CC_PREPROCESS)
+    return;
+  if (! (mode & (CC_COMPILE | CC_ASSEMBLE)))
+    {
+      if (! output)
+        found (arg, implied_name ("a.out", 5, ""), SIG_WRITE);
+      return;
+    }
+  int depend = (mode & CC_DEPEND) && ! (mode & CC_DEPEND_FILE);
+  if (output)
+    {
+      if (depend)
+        found (arg, implied_name (output, stem_length (output), ".d"),
+               SIG_WRITE);
+      return;
+    }
+
+  // Each source's outputs go in the working directory
+  size_t k;
+  for (k = 0; k < operand_count; k++)
+    if (source_file (operands[k]))
+      {
+        char const *slash = strrchr (operands[k], '/');
+        char const *base = slash ? slash + 1 : operands[k];
+        size_t len = stem_length (base);
+        found (arg, implied_name (base, len, mode & CC_ASSEMBLE ? ".s" : ".o"),
+               SIG_WRITE);
+        if (depend)
+          found (arg, implied_name (base, len, ".d"), SIG_WRITE);
+      }
+}
+
+int
+signature_files (char **word, void (*found) (void *, char *, int), void *arg)
+{
+  load_builtin_signatures ();
+  struct signature const *sig = find_signature (word[0]);
+  if (! sig)
+    return 0;
+
+  size_t word_count = 0;
+  while (word[word_count])
+    word_count++;
+  char **operands = checked_malloc (word_count * sizeof *operands);
+  size_t operand_count = 0;
+  int options_done = 0;
+  int all_starred = 0;
+  int mode = 0; // of a compiler
+  char *output = NULL; // the argument of a compiler's -o
+
+  char **w;
+  for (w = word + 1; *w; w++)
+    {
+      char *a = *w;
+      if (options_done || a[0] != '-' || ! a[1])
+        {
+          operands[operand_count++] = a;
+          continue;
+        }
+      if (! strcmp (a, "--"))
+        {
+          options_done = 1;
+          continue;
+        }
+
+      if (sig->compiler)
+        mode |= compiler_mode (a);
+      struct option_signature const *o;
+      char *rest = NULL;
+      if (a[1] == '-')
+        {
+          size_t len = strcspn (a, "=");
+          o = find_option (sig, a, len);
+          if (a[len])
+            rest = a + len + 1;
+        }
+      else if ((o = find_word_option (sig, a)))
+        rest = a + o->len;
+      else
+        {
+          size_t j;
+          for (j = 1; a[j]; j++)
+            {
+              char name[2] = { '-', a[j] };
+              if ((o = find_option (sig, name, 2)))
+                {
+                  rest = a + j + 1;
+                  break;
+                }
+            }
+        }
+
+      if (! o || ! o->takes_arg)
+        continue;
+      all_starred |= o->all_starred;
+      if (! rest || ! *rest)
+        {
+          if (! w[1])
+            break;
+          rest = *++w;
+        }
+      if (o->role)
+        found (arg, rest, o->role);
+      if (sig->compiler && ! strcmp (o->name, "-o"))
+        output = rest;
+      else if (sig->compiler && ! strcmp (o->name, "-MF"))
+        mode |= CC_DEPEND_FILE;
+    }
+
+  size_t prefix = sig->star < sig->operand_count ? sig->star : sig->operand_count;
+  size_t suffix = sig->operand_count - prefix - (sig->star < sig->operand_count);
+  size_t k;
+  for (k = 0; k < operand_count; k++)
+    {
+      int role;
+      if (all_starred && sig->star < sig->operand_count)
+        role = sig->operands[sig->star];
+      else if (k < prefix)
+        role = sig->operands[k];
+      else if (k + suffix >= operand_count)
+        role = sig->operands[sig->star + 1 + k + suffix - operand_count];
+      else if (sig->star < sig->operand_count)
+        role = sig->operands[sig->star];
+      else
+        role = SIG_READ | SIG_WRITE;
+      if (role)
+        found (arg, operands[k], role);
+    }
+  if (sig->compiler)
+    compiler_outputs (mode, output, operands, operand_count, found, arg);
+  free (operands);
+  return 1;
+}
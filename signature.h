@@ -0,0 +1,19 @@
+// UCLA CS 111 Lab 1 read/write signatures of common programs
+
+enum { SIG_READ = 1, SIG_WRITE = 2 };
+
+/* Add the signatures in FILE, which take precedence over the built-in
+   ones and those loaded earlier.  Exit with a diagnostic if FILE cannot
+   be read or is malformed.  */
+void load_signatures (char const *file);
+
+/* If there is a signature for the program named by WORD[0], call
+   FOUND (ARG, NAME, ROLE) for each file the null-terminated argument
+   vector WORD reads or writes, where ROLE is a mask of SIG_READ and
+   SIG_WRITE, and return 1.  Otherwise return 0.  */
+int signature_files (char **word, void (*found) (void *, char *, int),
+                     void *arg);
+
+/* Return a hash of every signature in use, which changes whenever
+   load_signatures adds different ones.  */
+unsigned long long signature_digest (void);
@@ -0,0 +1,36 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that the other tests that run commands pass
+# with simple commands started by fork and exec as well as by posix_spawn.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+top=$(pwd)
+
+(
+cd "$tmp" || exit
+
+# The tests run ../timetrash, so a copy of the tree whose timetrash passes
+# -x on runs them unchanged
+for f in "$top"/*; do
+  case $f in
+    *.tmp | */timetrash) ;;
+    *) ln -s "$f" . || exit;;
+  esac
+done
+
+for method in fork spawn; do
+  printf '#! /bin/sh\nexec %s/timetrash -x %s "$@"\n' "$top" $method >timetrash
+  chmod +x timetrash
+  for t in test-b-*.sh test-c-*-ok.sh; do
+    test $t = test-b-fork-ok.sh && continue
+    ./$t || {
+      echo "$t failed with -x $method"
+      exit 1
+    }
+  done
+done
+
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,44 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that pipeline stages run concurrently and that a
+# pipeline reports the status of its last stage.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+seq 1 200000 | sort -rn | tr 0-9 a-j | head -n 2
+
+true | false || echo last stage failed
+
+false | true && echo last stage succeeded
+
+(echo b; echo c; echo a) | sort | tr a-z A-Z > out
+
+cat < out | cat | cat
+EOF
+
+cat >test.exp <<'EOF'
+caaaaa
+bjjjjj
+last stage failed
+last stage succeeded
+A
+B
+C
+EOF
+
+../timetrash test.sh >test.out 2>test.err || exit
+
+diff -u test.exp test.out || exit
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,82 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that -a describes the time-travel graph of a
+# script without running it, and that -G writes the graph in DOT.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+sort a > sa
+
+sort b > sb
+
+cat sa > x
+
+cat sa x sb > both
+
+wc -l both
+
+echo unrelated > u
+EOF
+
+cat >test.exp <<'EOF'
+nodes: 6
+edges: 5
+edges after transitive reduction: 4
+critical path: 4 (4 nodes)
+maximum antichain width: 3
+sequential time: 6
+cores	makespan	speedup
+1	6	1.00
+2	4	1.50
+3	4	1.50
+critical path commands:
+1	1	sort a>sa
+3	1	cat sa>x
+4	1	cat sa x sb>both
+5	1	wc -l both
+EOF
+
+cat >test.dot.exp <<'EOF'
+digraph timetrash {
+  node [shape=box];
+  n1 [label="sort a>sa", color=red];
+  n2 [label="sort b>sb"];
+  n3 [label="cat sa>x", color=red];
+  n4 [label="cat sa x sb>both", color=red];
+  n5 [label="wc -l both", color=red];
+  n6 [label="echo unrelated>u"];
+  n1 -> n3 [label="sa", color=red];
+  n1 -> n4 [label="sa", style=dotted];
+  n2 -> n4 [label="sb"];
+  n3 -> n4 [label="x", color=red];
+  n4 -> n5 [label="both", color=red];
+}
+EOF
+
+../timetrash -a -j 3 -G test.dot test.sh >test.out 2>test.err || exit
+diff -u test.exp test.out || exit
+diff -u test.dot.exp test.dot || exit
+test ! -s test.err || exit
+test ! -f sa && test ! -f u || exit
+
+# With a profile, nodes cost their last wall time
+cat >slow.sh <<'EOF'
+sleep 1 > a
+
+sleep 0 > b
+
+cat a b > c
+EOF
+../timetrash -t -P prof slow.sh || exit
+../timetrash -a -P prof slow.sh >test.out || exit
+awk '/^critical path:/ { exit !($3 >= 1 && $3 < 2 && $4 == "(2") }' test.out || exit
+grep -q '^1	[0-9.]*	sleep 1>a$' test.out || exit
+
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,162 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test the library's asynchronous execution: handles
+# run in the background, poll as finished through their descriptors, and
+# a batch of scripts runs as one time-travel graph.  The library exports
+# nothing beyond command.h, and waits only for the children it started.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >runner.c <<'EOF'
+#include "command.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Names the library uses inside may be the program's own
+int line, tracing;
+int intern (void) { return 0; }
+void add_edge (void) {}
+
+static int
+get_byte (void *stream)
+{
+  return getc (stream);
+}
+
+static command_stream_t
+open_stream (char const *name)
+{
+  FILE *f = fopen (name, "r");
+  if (! f)
+    exit (2);
+  return make_command_stream (get_byte, f);
+}
+
+int
+main (void)
+{
+  // One slow command, started before a quick one, finishes after it
+  command_stream_t s = open_stream ("slow.sh");
+  command_handle_t slow = execute_command_async (read_command_stream (s), 0);
+  if (command_poll (slow))
+    return 3;
+
+  command_stream_t t = open_stream ("quick.sh");
+  command_t quick_command = read_command_stream (t);
+  command_handle_t quick = execute_command_async (quick_command, 1);
+  struct pollfd p = { command_handle_fd (quick), POLLIN, 0 };
+  if (p.fd >= 0 && poll (&p, 1, 5000) != 1)
+    return 4;
+  if (WEXITSTATUS (command_wait (quick)) != 1
+      || WEXITSTATUS (command_status (quick_command)) != 1)
+    return 5;
+  if (command_poll (slow))
+    return 6;
+  printf ("quick done\n");
+  fflush (stdout);
+  if (command_wait (slow) != 0)
+    return 7;
+  printf ("slow done\n");
+  command_handle_free (slow);
+  command_handle_free (quick);
+
+  // Pipelines and graphs leave the program's own children to it
+  command_stream_t w = open_stream ("own.sh");
+  command_t own_command = read_command_stream (w);
+  int time_travel;
+  for (time_travel = 0; time_travel <= 1; time_travel++)
+    {
+      int own_status;
+      pid_t own = fork ();
+      if (own == 0)
+        _exit (7);
+      execute_command (own_command, time_travel);
+      if (waitpid (own, &own_status, 0) != own || WEXITSTATUS (own_status) != 7)
+        return 8;
+    }
+
+  // A batch: the commands of a.sh and b.sh in one graph
+  command_t commands[4];
+  size_t n = 0;
+  command_stream_t a = open_stream ("a.sh"), b = open_stream ("b.sh");
+  command_t c;
+  while ((c = read_command_stream (a)))
+    commands[n++] = c;
+  while ((c = read_command_stream (b)))
+    commands[n++] = c;
+  command_handle_t batch = execute_time_travel_async (commands, n);
+  while (! command_poll (batch))
+    poll (NULL, 0, 10);
+  size_t i;
+  for (i = 0; i < n; i++)
+    printf ("%d\n", WEXITSTATUS (command_status (commands[i])));
+  command_handle_free (batch);
+
+  // Freeing a handle kills the processes its commands started
+  command_stream_t l = open_stream ("leak.sh");
+  command_t leak = read_command_stream (l);
+  command_handle_t leaky = execute_time_travel_async (&leak, 1);
+  poll (NULL, 0, 300);
+  command_handle_free (leaky);
+  return 0;
+}
+EOF
+
+cat >slow.sh <<'EOF'
+sleep 1
+EOF
+
+cat >quick.sh <<'EOF'
+echo quick; false
+EOF
+
+cat >own.sh <<'EOF'
+(sleep 1 | cat; true)
+EOF
+
+cat >a.sh <<'EOF'
+sleep 1 && echo from a > shared
+
+cat shared > a.out
+EOF
+
+cat >b.sh <<'EOF'
+cat shared > b.out
+
+false
+EOF
+
+cat >leak.sh <<'EOF'
+sleep 1 && echo leaked > leaked
+EOF
+
+cat >test.exp <<'EOF'
+quick
+quick done
+slow done
+0
+0
+0
+1
+EOF
+
+gcc -I.. -o runner runner.c ../libtimetrash.a || exit
+./runner >test.out 2>test.err || exit
+diff -u test.exp test.out || exit
+test ! -s test.err || exit
+echo from a | diff -u - a.out || exit
+echo from a | diff -u - b.out || exit
+sleep 1.5
+test ! -f leaked || exit
+
+) || exit
+
+rm -fr "$tmp"
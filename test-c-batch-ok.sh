@@ -0,0 +1,57 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that several scripts run as one time-travel
+# graph, ordered where they share files, and that each one's exit status
+# is reported.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+# a.sh writes the file b.sh reads, but takes longer to get there
+cat >a.sh <<'EOF'
+sleep 1 && echo from a > shared
+
+cat shared > a.out
+EOF
+
+cat >b.sh <<'EOF'
+cat shared > b.out
+
+false
+EOF
+
+cat >c.sh <<'EOF'
+sleep 1
+EOF
+
+: >empty.sh
+
+cat >test.exp <<'EOF'
+a.sh: exit status 0
+b.sh: exit status 1
+c.sh: exit status 0
+empty.sh: exit status 0
+EOF
+
+for opt in '' -t '-t -j 1'; do
+  rm -f shared a.out b.out
+  ../timetrash $opt a.sh b.sh c.sh empty.sh >test.out 2>test.err
+  test $? -eq 1 || exit
+  diff -u test.exp test.err || exit
+  test ! -s test.out || exit
+  echo from a | diff -u - a.out || exit
+  echo from a | diff -u - b.out || exit
+done
+
+# The sleeps of a.sh and c.sh overlap
+start=$(date +%s%N)
+../timetrash -t -j 2 a.sh c.sh 2>test.err || exit
+end=$(date +%s%N)
+test $(((end - start) / 1000000)) -lt 1800 || exit
+
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,56 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that time travel with -b emits each command's
+# output in script order, whichever command finishes first.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+sleep 1 && echo first
+
+echo second
+
+(sleep 0.5 && echo third; cat missing; echo third-end)
+
+seq 100000 | tail -n 1
+
+sleep 0.5 && false
+EOF
+
+cat >test.exp <<'EOF'
+first
+second
+third
+cat: missing: No such file or directory
+third-end
+100000
+EOF
+
+../timetrash -b -t -j 8 test.sh >test.out 2>&1 && exit 1
+diff -u test.exp test.out || exit
+
+# Separate files get their own streams, each in order
+../timetrash -b -t -j 8 test.sh >test.out 2>test.err && exit 1
+grep -v '^cat:' test.exp | diff -u - test.out || exit
+grep '^cat:' test.exp | diff -u - test.err || exit
+
+# Out of descriptors for buffers, nodes wait for earlier output to flush
+{
+  echo 'sleep 1'
+  for i in $(seq 100); do
+    echo
+    echo "echo $i"
+  done
+} >many.sh
+(ulimit -n 64 && ../timetrash -b -t -j 8 many.sh >test.out 2>test.err) || exit
+seq 100 | diff -u - test.out || exit
+test ! -s test.err || exit
+exit 0
+
+) || exit
+
+rm -fr "$tmp"
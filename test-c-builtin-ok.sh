@@ -0,0 +1,86 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test the builtins that run without forking: true,
+# false, :, echo and a bare exec.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+long=$(seq 2000 | tr '\n' ' ')
+
+cat >test.sh <<EOF
+: ignored words
+
+true && echo and
+
+false || echo or
+
+echo -n no newline; echo
+
+echo -e -n e; echo
+
+echo -E plain
+
+exec echo exec
+
+exec > created
+
+echo to file > out; cat out
+
+echo piped | tr a-z A-Z | cat
+
+echo $long | wc -w
+
+true < missing || echo missing input
+
+true --version | head -n 1 | grep -q true && echo real true
+
+false
+EOF
+
+cat >test.exp <<'EOF'
+and
+or
+no newline
+e
+plain
+exec
+to file
+PIPED
+2000
+missing input
+real true
+EOF
+
+for opt in '' -t; do
+  # Time travel may run independent lines in any order
+  ../timetrash $opt test.sh >test.out 2>test.err
+  test $? -eq 1 || exit
+  test -f created && test ! -s created || exit
+  sort test.exp >test.exp.sorted
+  sort test.out | diff -u test.exp.sorted - || exit
+  grep -q 'failure to open input file missing' test.err || exit
+  grep -v 'failure to open input file missing' test.err && exit 1
+  rm created
+done
+
+# An echo into a closed stdout fails as the real one would, without
+# killing timetrash
+cat >closed.sh <<'EOF'
+sleep 0.5
+
+echo lost
+
+echo after > after.out
+EOF
+{ ../timetrash closed.sh; echo $? >rc; } | true
+echo 0 | diff -u - rc || exit
+echo after | diff -u - after.out || exit
+exit 0
+
+) || exit
+
+rm -fr "$tmp"
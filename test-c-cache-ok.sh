@@ -0,0 +1,65 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that -c runs a script from its cache, and
+# rebuilds the cache when the script changes.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+echo hello > a
+
+cat a | tr a-z A-Z > b; echo two
+
+(cat b && echo sub) || echo no
+
+sort < b > c
+EOF
+
+cat >test.exp <<'EOF'
+two
+HELLO
+sub
+EOF
+
+for opt in '' -t; do
+  rm -f cache
+  ../timetrash $opt -c cache test.sh >test.out 2>test.err || exit
+  diff -u test.exp test.out || exit
+  test -s cache || exit
+  inode=$(ls -i cache)
+
+  # The cache is used as it is, once per option
+  ../timetrash $opt -c cache test.sh >test.out 2>>test.err || exit
+  diff -u test.exp test.out || exit
+  ../timetrash -t -c cache test.sh >test.out 2>>test.err || exit
+  sort test.out >test.sorted
+  sort test.exp | diff -u - test.sorted || exit
+  test "$(ls -i cache)" = "$inode" || exit
+done
+
+# A changed script replaces the cache, and its exit status is kept
+echo false >>test.sh
+../timetrash -c cache test.sh >test.out 2>>test.err && exit 1
+diff -u test.exp test.out || exit
+test "$(ls -i cache)" != "$inode" || exit
+inode=$(ls -i cache)
+../timetrash -t -c cache test.sh >test.out 2>>test.err && exit 1
+test "$(ls -i cache)" = "$inode" || exit
+
+# A cache that does not match is rebuilt, not trusted
+echo garbage >cache
+../timetrash -c cache test.sh >test.out 2>>test.err && exit 1
+diff -u test.exp test.out || exit
+
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,46 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that time travel keeps commands that share files
+# in script order, and that an empty script is accepted.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+sleep 1 && echo one > f
+
+cat f f
+
+echo two > f
+
+sleep 1 && cat f > g
+
+echo three > g; cat g
+
+echo unrelated
+EOF
+
+cat >test.exp <<'EOF'
+unrelated
+one
+one
+three
+EOF
+
+../timetrash -t -j 4 test.sh >test.out 2>test.err || exit
+diff -u test.exp test.out || exit
+
+: >empty.sh
+../timetrash -t empty.sh >>test.err 2>&1 || exit
+
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+) || exit
+
+rm -fr "$tmp"
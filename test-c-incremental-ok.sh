@@ -0,0 +1,57 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that time travel with a state file reruns only
+# the commands whose files changed since their last successful run.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+printf '#! /bin/sh\necho "$1" >>log\ncat "$1"\n' >step || exit
+chmod +x step || exit
+echo A >a || exit
+echo X >x || exit
+
+cat >test.sh <<'EOF'
+./step a > b
+
+./step b > c
+
+./step x > y
+
+./step missing > z
+
+echo done
+EOF
+
+run () {
+  : >log
+  ../timetrash -t -i state test.sh >test.out 2>>test.err
+  sort log | tr '\n' ' ' >test.log; echo >>test.log
+  echo "$1" | diff -u - test.log || exit
+}
+
+run 'a b missing x '
+# Nothing changed, but the failed command is tried again
+run 'missing '
+echo XX >x
+run 'missing x '
+echo AA >a
+run 'a b missing '
+rm c
+run 'b missing '
+
+grep -q 'A' c || exit
+grep -q 'missing' state && exit 1
+
+# Without -t there is nothing to skip, and -i is refused
+../timetrash -i state test.sh >test.out 2>test.err && exit 1
+grep -q usage test.err || exit
+test ! -s test.out || exit
+exit 0
+
+) || exit
+
+rm -fr "$tmp"
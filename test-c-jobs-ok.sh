@@ -0,0 +1,50 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that -j and a make jobserver limit how many
+# commands time travel runs at once.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+sleep 1 && echo a
+
+echo b
+EOF
+
+echo 'a
+b' >serial.exp || exit
+echo 'b
+a' >parallel.exp || exit
+
+# One slot runs the nodes in order; two let the second finish first.
+../timetrash -t -j 1 test.sh >test1.out 2>test.err || exit
+diff -u serial.exp test1.out || exit
+../timetrash -t -j 2 test.sh >test2.out 2>>test.err || exit
+diff -u parallel.exp test2.out || exit
+
+# A jobserver pipe holding no tokens leaves only our own implicit slot;
+# one token allows a second node, and the token is handed back.
+mkfifo tokens || exit
+exec 3<>tokens 4>tokens
+MAKEFLAGS=' -j2 --jobserver-auth=3,4' \
+  ../timetrash -t test.sh >test3.out 2>>test.err || exit
+diff -u serial.exp test3.out || exit
+printf + >&4
+MAKEFLAGS=' -j2 --jobserver-auth=3,4' \
+  ../timetrash -t test.sh >test4.out 2>>test.err || exit
+diff -u parallel.exp test4.out || exit
+token=$(timeout 5 dd bs=1 count=1 <&3 2>/dev/null)
+test "$token" = + || exit
+
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+) || exit
+
+rm -fr "$tmp"
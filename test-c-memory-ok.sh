@@ -0,0 +1,51 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that time travel with -m keeps nodes expected
+# to use more memory than the budget allows from running together, runs
+# cheap nodes meanwhile, and learns each node's peak in the profile.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+sleep 1 > a
+
+sleep 1 > b
+
+sleep 1 > c
+EOF
+
+# a and b are known to take 100 MB each, c only 1 MB
+printf '1.0\t100000\tsleep 1>a\n1.0\t100000\tsleep 1>b\n1.0\t1000\tsleep 1>c\n' >prof
+
+elapsed() {
+  start=$(date +%s%N)
+  "$@" || exit
+  end=$(date +%s%N)
+  echo $(((end - start) / 1000000))
+}
+
+# Without a budget all three run at once
+ms=$(elapsed ../timetrash -t -j 3 test.sh) || exit
+test $ms -lt 1800 || exit
+
+# With room for one of a and b, c runs next to a, then b
+cp prof prof.m
+ms=$(elapsed ../timetrash -t -j 3 -m 150M -P prof.m test.sh) || exit
+test $ms -ge 1900 && test $ms -lt 2800 || exit
+
+# The profile now holds the peaks the commands really had
+test $(grep -c '	[0-9]*	sleep 1>[abc]$' prof.m) -eq 3 || exit
+grep -q '	100000	' prof.m && exit 1
+
+# Without a profile, peaks are learned as the run goes
+ms=$(elapsed ../timetrash -t -j 3 -m 1G test.sh) || exit
+test $ms -lt 1800 || exit
+exit 0
+
+) || exit
+
+rm -fr "$tmp"
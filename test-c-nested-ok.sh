@@ -0,0 +1,110 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that time travel runs the sequences inside
+# subshells in parallel, keeping && and || and the subshell's status.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+(sleep 3 && echo a; echo b)
+
+false && (echo no; echo no)
+
+(true; sleep 0.5; false) || (echo failed; (sleep 1; echo x > f; cat f))
+
+(true; false)
+EOF
+
+cat >test1.exp <<'EOF'
+a
+b
+failed
+x
+EOF
+
+cat >test2.exp <<'EOF'
+b
+failed
+x
+a
+EOF
+
+# One job slot is shared by every level, so nothing overlaps
+../timetrash -t -j 1 test.sh >test1.out 2>test.err
+test $? -eq 1 || exit
+diff -u test1.exp test1.out || exit
+../timetrash -t -j 4 test.sh >test2.out 2>>test.err
+test $? -eq 1 || exit
+diff -u test2.exp test2.out || exit
+
+# The library runs a subshell's sequence the same way, setting up its
+# own job slots
+cat >runner.c <<'EOF'
+#include "command.h"
+
+#include <stdio.h>
+#include <sys/wait.h>
+
+static int
+get_byte (void *stream)
+{
+  return getc (stream);
+}
+
+int
+main (int argc, char **argv)
+{
+  FILE *f = fopen (argv[1], "r");
+  if (! f)
+    return 2;
+  command_stream_t s = make_command_stream (get_byte, f);
+  command_t c = read_command_stream (s);
+  execute_command (c, 1);
+  int status = command_status (c);
+  if (WIFSIGNALED (status))
+    printf ("signal %d\n", WTERMSIG (status));
+  else
+    printf ("%d\n", WEXITSTATUS (status));
+  return 0;
+}
+EOF
+
+cat >sub.sh <<'EOF'
+(echo a; sleep 1 && echo b; false)
+EOF
+
+cat >test3.exp <<'EOF'
+a
+b
+1
+EOF
+
+gcc -I.. -o runner runner.c ../libtimetrash.a || exit
+timeout 10 ./runner sub.sh >test3.out 2>>test.err || exit
+diff -u test3.exp test3.out || exit
+
+# A command killed by a signal gives the same status as it does sequentially
+cat >die <<'EOF'
+#! /bin/sh
+kill -TERM $$
+EOF
+chmod +x die
+cat >killed.sh <<'EOF'
+(true; ./die)
+EOF
+echo signal 15 >test4.exp
+timeout 10 ./runner killed.sh >test4.out 2>>test.err || exit
+diff -u test4.exp test4.out || exit
+
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+) || exit
+
+rm -fr "$tmp"
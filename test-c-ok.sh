@@ -20,7 +20,7 @@ cruel
 world
 EOF
 
-../timetrash -t test.sh >test.out 2>test.err || exit
+../timetrash -t -j 3 test.sh >test.out 2>test.err || exit
 
 diff -u test.exp test.out || exit
 test ! -s test.err || {
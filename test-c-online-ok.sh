@@ -0,0 +1,76 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that time travel runs the commands of a script
+# read from a pipe as they arrive, still ordered where they share files.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+# The generator only goes on once the first command has run
+generate() {
+  echo 'echo first > first.out'
+  echo
+  i=0
+  while test ! -f first.out && test $i -lt 50; do
+    sleep 0.1
+    i=$((i + 1))
+  done
+  test -f first.out && echo 'echo early > early.out'
+  echo
+  echo 'sleep 1 && echo slow > shared'
+  echo
+  echo 'cat shared > copy'
+  echo
+  echo 'cat first.out'
+  echo
+  echo 'false'
+}
+
+cat >test.exp <<'EOF'
+first
+EOF
+
+for opt in -t '-t -b' '-t -j 1'; do
+  rm -f first.out early.out shared copy
+  generate | ../timetrash $opt /dev/stdin >test.out 2>test.err
+  test $? -eq 1 || exit
+  diff -u test.exp test.out || exit
+  test ! -s test.err || exit
+  echo early | diff -u - early.out || exit
+  echo slow | diff -u - copy || exit
+done
+
+# A regular script after the pipe waits on the pipe's commands
+echo 'cat shared > copy2' >after.sh
+rm -f shared
+generate | ../timetrash -t /dev/stdin after.sh >test.out 2>test.err
+test $? -eq 1 || exit
+echo slow | diff -u - copy2 || exit
+
+# A syntax error partway through waits for the commands before it
+printf 'sleep 1 && echo done > done.out\n\n&& oops\n' >bad.sh
+cat bad.sh | ../timetrash -t /dev/stdin >test.out 2>test.err
+test $? -eq 1 || exit
+test -s test.err || exit
+echo done | diff -u - done.out || exit
+
+# A forked command that exits with an error while the script is still
+# being read does not run the nodes queued behind it
+cat >queued.sh <<'EOF'
+sleep 1 && echo hi > x
+
+cat x < missing
+
+cat x
+EOF
+rm -f x
+(cat queued.sh; sleep 2) | ../timetrash -x fork -t -j 1 /dev/stdin >test.out 2>test.err
+test $? -eq 0 || exit
+echo hi | diff -u - test.out || exit
+
+) || exit
+
+rm -fr "$tmp"
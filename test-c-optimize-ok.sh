@@ -0,0 +1,78 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that -O drops useless cats from pipelines,
+# shows the result with -p, and runs it with the same output.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+seq 100000 >in || exit
+
+cat >test.sh <<'EOF'
+cat < in | tr 1 x | sort -u | cat | wc -l
+
+cat in | cat | cat > copy || echo failed
+
+cat -n in | tail -n 1
+
+cat in in | wc -l
+
+echo y | cat | tr y Y
+
+(cat in | grep -c 9) | cat
+EOF
+
+cat >test.exp <<'EOF'
+# 1
+    tr 1 x<in \
+  |
+    sort -u \
+  |
+    wc -l
+# 2
+    cat<in>copy \
+  ||
+    echo failed
+# 3
+    cat -n in \
+  |
+    tail -n 1
+# 4
+    cat in in \
+  |
+    wc -l
+# 5
+    echo y \
+  |
+    tr y Y
+# 6
+    (
+     grep -c 9<in
+    ) \
+  |
+    cat
+EOF
+
+../timetrash -p -O test.sh >test.out 2>test.err || exit
+diff -u test.exp test.out || exit
+
+../timetrash test.sh >test.exp 2>>test.err || exit
+for opt in -O '-O -t'; do
+  rm copy
+  ../timetrash $opt test.sh >test.out 2>>test.err || exit
+  sort test.exp >test.exp.sorted
+  sort test.out | diff -u test.exp.sorted - || exit
+  cmp in copy || exit
+done
+
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,45 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that time travel starts the longest paths of a
+# profiled script first, and records the times of this run.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+echo a
+
+echo b > f
+
+cat f
+EOF
+
+printf '0.001\techo a\n1.000\techo b>f\n0.002\tcat f\n0.5\tother\n' >prof || exit
+
+echo 'a
+b' >test1.exp || exit
+echo 'b
+a' >test2.exp || exit
+
+# Without a profile, ready nodes start in script order
+../timetrash -t -j 1 test.sh >test1.out 2>test.err || exit
+diff -u test1.exp test1.out || exit
+../timetrash -t -j 1 -P prof test.sh >test2.out 2>>test.err || exit
+diff -u test2.exp test2.out || exit
+
+# Each command has a new time, and entries for other scripts are kept
+test $(wc -l <prof) -eq 4 || exit
+grep -q '^0\.500000	other$' prof || exit
+grep -q '^1\.000000' prof && exit 1
+
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,96 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that time travel uses program signatures to
+# find which words are files read and written.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+sleep 1 && cp a b
+
+cat b
+
+sleep 2 && echo late > c
+
+echo c
+
+sleep 3 && sort -o d e
+
+cat d
+EOF
+
+echo A >a || exit
+echo E >e || exit
+
+cat >test1.exp <<'EOF'
+c
+A
+E
+EOF
+
+# Override echo so that its arguments count as files read
+echo 'echo r* # comment' >sigs || exit
+cat >test2.exp <<'EOF'
+A
+c
+E
+EOF
+
+../timetrash -t -j 8 test.sh >test1.out 2>test.err || exit
+diff -u test1.exp test1.out || exit
+../timetrash -t -j 8 -s sigs test.sh >test2.out 2>>test.err || exit
+diff -u test2.exp test2.out || exit
+
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+echo 'cp r* x' >bad || exit
+../timetrash -t -s bad test.sh 2>/dev/null && exit 1
+
+# Compilers write files no option names, and -MD takes no argument
+cat >cc.sh <<'EOF'
+gcc -MD foo.c -o foo
+
+echo x > foo.c
+
+gcc -c -MMD bar.c
+
+cat bar.o bar.d
+
+gcc baz.c
+
+cat a.out
+EOF
+../timetrash -a cc.sh >test.out || exit
+grep -q '^edges: 3$' test.out || exit
+
+# cp -t reads every operand, grep's first operand is a pattern, and a
+# long single-dash option is not split into letters: only echo x > a waits
+cat >ops.sh <<'EOF'
+cp -t dir a b
+
+cat b
+
+echo x > a
+
+grep pat f
+
+echo x > pat
+
+gcc -isysroot /x -c g.c
+
+cat ot
+EOF
+../timetrash -a ops.sh >test.out || exit
+grep -q '^edges: 1$' test.out || exit
+
+exit 0
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,71 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that -S runs the right side of && and || while
+# the left side runs, keeping its files and output only if it should have
+# run, and runs the right sides it cannot divert afterwards as usual.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+elapsed() {
+  start=$(date +%s%N)
+  "$@" || exit
+  end=$(date +%s%N)
+  echo $(((end - start) / 1000000))
+}
+
+# Both sides sleep at once
+cat >overlap.sh <<'EOF'
+sleep 1 && sleep 1 > a
+
+(sleep 1; false) || sleep 1 > b
+EOF
+ms=$(elapsed ../timetrash -S overlap.sh </dev/null) || exit
+test $ms -lt 2800 || exit
+test -f a && test -f b || exit
+
+# A right side that should not have run leaves nothing behind, and one
+# that may write files no redirect names waits
+echo old >kept
+echo 'int x;' >foo.c
+cat >discard.sh <<'EOF'
+sleep 1 && false && echo new > kept
+
+true || echo new > kept
+
+sleep 1 && false && gcc -c foo.c
+
+echo out && echo right
+
+cat kept
+EOF
+
+cat >discard.exp <<'EOF'
+out
+right
+old
+EOF
+
+../timetrash -S discard.sh </dev/null >test.out 2>test.err || exit
+diff -u discard.exp test.out || exit
+test ! -s test.err || exit
+test $(ls -a | grep -c spec) -eq 0 || exit
+test ! -f foo.o || exit
+
+# A right side reading what the left side writes waits for it, and one
+# that may read stdin does not take it
+cat >wait.sh <<'EOF'
+echo first > c && cat c > d
+
+true && cat > e
+EOF
+echo input | ../timetrash -S wait.sh || exit
+echo first | diff -u - d || exit
+echo input | diff -u - e || exit
+
+) || exit
+
+rm -fr "$tmp"
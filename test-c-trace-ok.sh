@@ -0,0 +1,49 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that -T writes a trace with a span for every
+# node, command and pipeline stage, builtins included.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+
+cat >test.sh <<'EOF'
+echo a | tr a b > out
+
+sleep 1 && cat out
+
+sleep 1
+EOF
+
+../timetrash -t -j 2 -T trace.json test.sh >test.out 2>test.err || exit
+echo b | diff -u - test.out || exit
+../timetrash -T seq.json test.sh >test.out 2>>test.err || exit
+echo b | diff -u - test.out || exit
+
+for t in trace seq; do
+  head -n 1 $t.json | grep -qx '\[' || exit
+  tail -n 1 $t.json | grep -qx '\]' || exit
+  grep -q '"name":"echo a","ph":"X".*"builtin":true' $t.json || exit
+  for name in 'tr a b>out' 'sleep 1' 'cat out'; do
+    grep -q "\"name\":\"$name\",\"ph\":\"X\".*\"maxrss_kb\"" $t.json || {
+      echo >&2 "$t.json: no span for $name"
+      exit 1
+    }
+  done
+done
+
+# Time travel adds a span per node, on the track of its job slot
+grep -q '"args":{"name":"slot 2"}' trace.json || exit
+grep -q '"name":"sleep 1 && cat out",.*"queued_us"' trace.json || exit
+test $(grep -c '"name":"fork"' trace.json) -eq 3 || exit
+
+test ! -s test.err || {
+  cat test.err
+  exit 1
+}
+
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,69 @@
+#! /bin/sh
+
+# UCLA CS 111 Lab 1 - Test that scripts parsed from a mapped file produce
+# the same trees and errors as scripts read byte by byte from a pipe.
+
+tmp=$0-$$.tmp
+mkdir "$tmp" || exit
+
+(
+cd "$tmp" || exit
+status=
+
+long=abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!%+,-./:@^_
+
+cat >test1.sh <<EOF
+true
+
+g++ -c foo.c
+
+cat < /etc/passwd | tr a-z A-Z | sort -u > out || echo sort failed!
+
+a&&b||
+ c &&
+  d | e && f|
+
+g<h
+
+# comment with odd characters \` " ' \$ * ? [ ] { } ~ = \\ and a tab	here
+a<b>c|d<e>f|g<h>i
+(  $long$long ;	$long
+ x$long ) > y$long
+0123456789abcde 0123456789abcdef 0123456789abcdefg
+0123456789abcdef0123456789abcde 0123456789abcdef0123456789abcdef
+0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0
+EOF
+
+printf 'echo no trailing newline' >test2.sh
+printf 'a;b\n#\n\n\n   \n(c)\n%s' "$long" >test3.sh
+printf 'echo %s=bad\n' "$long" >test4.sh
+printf 'echo ok\necho %s\200x\n' "$long" >test5.sh
+printf 'a b c | d e f & g\n' >test6.sh
+printf '(a\n\n b\n)\n( (a)\n' >test7.sh
+printf 'a >\nb\n' >test8.sh
+printf 'a%s b\n' "$long$long" | tr '^' '\001' >test9.sh
+
+kernels=scalar
+case $(uname -m) in
+  x86_64 | i?86)
+    kernels="$kernels sse2"
+    grep -qw avx2 /proc/cpuinfo 2>/dev/null && kernels="$kernels avx2";;
+esac
+
+for t in test*.sh; do
+  cat $t | ../timetrash -p /dev/stdin >$t.exp 2>$t.experr
+  echo $? >>$t.exp
+  for k in $kernels; do
+    TIMETRASH_SCAN=$k ../timetrash -p $t >$t.out 2>$t.err
+    echo $? >>$t.out
+    diff -u $t.exp $t.out && diff -u $t.experr $t.err || {
+      echo >&2 "$t: $k kernel differs from byte-by-byte parse"
+      status=1
+    }
+  done
+done
+
+exit $status
+) || exit
+
+rm -fr "$tmp"
@@ -0,0 +1,1501 @@
+// UCLA CS 111 Lab 1 time travel: graphs of commands run in parallel
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <time.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+# define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#include "command.h"
+#include "command-internals.h"
+#include "alloc.h"
+#include "jobserver.h"
+#include "signature.h"
+#include "time-travel.h"
+#include "trace.h"
+
+#define DEBUG 0
+#define WORDMIN 2
+
+// Memory admission: nodes expected to use at most CHEAP_MEMORY kB start
+// even while PSI reports more than PRESSURE_LIMIT percent of the last 10
+// seconds stalled on memory.  A node never seen, with no other to go by,
+// is expected to use UNKNOWN_MEMORY kB.  Up to HOLD_MAX ready nodes that do
+// not fit are passed over at a time in search of one that does.
+#define CHEAP_MEMORY 32768
+#define UNKNOWN_MEMORY 65536
+#define PRESSURE_LIMIT 10.0
+#define HOLD_MAX 64
+
+int travel_max_jobs;
+int travel_jobserver_fd = -1;
+int travel_buffered;
+int travel_optimizing;
+long travel_memory_budget;
+static int travel_nested; // running the graph of a subshell's sequence
+
+// Sets the limits of time travel to max_jobs nodes at once.  Without
+// max_jobs, shares make's job slots if run under make -j, or else runs one
+// node per online CPU.  Subshells run their sequences as graphs of their
+// own; a jobserver of our own keeps all of them within max_jobs.
+void setup_travel_jobs (int max_jobs) {
+    int jobserver_fd = -1;
+    if (!max_jobs && (jobserver_fd = jobserver_connect ()) >= 0)
+        max_jobs = INT_MAX;
+    if (!max_jobs && (max_jobs = sysconf (_SC_NPROCESSORS_ONLN)) < 1)
+        max_jobs = 1;
+    if (jobserver_fd < 0 && (jobserver_fd = jobserver_create (max_jobs - 1)) >= 0)
+        max_jobs = INT_MAX;
+    travel_max_jobs = max_jobs;
+    travel_jobserver_fd = jobserver_fd;
+}
+
+// Allocates a graph_node instance that points to command and holds dependency info
+graph_node *parse_io (command_t command, int command_number) {
+    graph_node *node = (graph_node *) checked_malloc (sizeof (graph_node));
+    node->command = command;
+    node->seq_no = command_number;
+    node->outputs = extract_io (command, 'o');
+    node->inputs = extract_io (command, 'i');
+    node->in_edges = 0;
+    node->max_edge_count = 0;
+    node->edge_count = 0;
+    node->out_edges = NULL;
+    node->last_dst = NULL;
+    node->rank = 0;
+    node->profile_id = 0;
+    node->state_id = 0;
+    node->dirty = 0;
+    node->done = 0;
+    node->memory = 0;
+
+    if (DEBUG) {
+        printf ("\n\toutputs: ");
+        char **w = node->outputs;
+        while (*w) {
+            printf("%s ", *w);
+            *w++;
+        }
+        printf ("\n\tinputs: ");
+        w = node->inputs;
+        while (*w) {
+            printf("%s ", *w);
+            *w++;
+        }
+        printf ("\n");
+    }
+    return node;
+}
+
+// Returns list of words from command that are classified as input/output ('i' or 'o')
+char **extract_io (command_t command, char io) {
+    size_t max_word_count = WORDMIN;
+    size_t max_size = max_word_count * sizeof (char *);
+    size_t word_count = 0;
+    char **words = (char **) checked_malloc (max_size);
+    words[0] = 0;
+    char **words1 = NULL, **words2 = NULL;
+    
+    if (command->type == SIMPLE_COMMAND) {
+        if (io == 'o') {
+            if (command->output) {
+                words[word_count] = command->output;
+                word_count++;
+            }
+        } else if (io == 'i') {
+            if (command->input) {
+                words[word_count] = command->input;
+                word_count++;
+            }
+        }
+        words[word_count] = 0;
+
+        // Known programs say which arguments they read and write; for the
+        // rest, every word up to the first option may be read
+        word_list files = { words, word_count, max_size, io == 'o' ? SIG_WRITE : SIG_READ };
+        if (signature_files (command->u.word, add_word, &files)) {
+            words = files.words;
+            word_count = files.count;
+            max_size = files.max_size;
+            max_word_count = max_size / (sizeof (char *));
+        } else if (io == 'i') {
+            char **w = command->u.word;
+            while (*w && *w[0] != '-') {
+                words[word_count] = *w;
+                word_count++;
+                if (word_count == max_word_count) {
+                    words = checked_grow_alloc (words, &max_size);
+                    max_word_count = max_size / (sizeof (char *));
+                }
+                words[word_count] = 0;
+                *++w;
+            }
+        }
+    } else if (command->type == SUBSHELL_COMMAND) { // Note: not supporting redirects after subshells
+        words1 = extract_io (command->u.subshell_command, io);
+    } else {
+        words1 = extract_io (command->u.command[0], io);
+        words2 = extract_io (command->u.command[1], io);
+    }
+    
+    words[word_count] = 0;
+    
+    // append words1/2 to words; repeats are skipped by add_dependencies
+    char **w;
+    if (words1) {
+        w = words1;
+        while (*w) {
+            words[word_count] = *w;
+            word_count++;
+            if (word_count == max_word_count) {
+                words = checked_grow_alloc (words, &max_size);
+                max_word_count = max_size / (sizeof (char *));
+            }
+            *w++;
+        }
+        free (words1);
+    }
+    words[word_count] = 0;
+
+    if (words2) {
+        w = words2;
+    
+        while (*w) {
+            words[word_count] = *w;
+            word_count++;
+            if (word_count == max_word_count) {
+                words = checked_grow_alloc (words, &max_size);
+                max_word_count = max_size / (sizeof (char *));
+            }
+            *w++;
+        }
+        free (words2);
+    }
+    words[word_count] = 0;
+    return words;
+}
+
+// Appends word to the word_list list if it has the list's role
+void add_word (void *list, char *word, int role) {
+    word_list *l = list;
+    if (!(role & l->role))
+        return;
+    l->words[l->count] = word;
+    l->count++;
+    if (l->count == l->max_size / sizeof (char *))
+        l->words = checked_grow_alloc (l->words, &l->max_size);
+    l->words[l->count] = 0;
+}
+
+static size_t
+hash_name (char const *name)
+{
+    size_t h = 2166136261u; // FNV-1a
+    for (; *name; name++)
+        h = (h ^ (unsigned char) *name) * 16777619u;
+    return h;
+}
+
+// Returns the index of name in table, adding it if it is new
+size_t intern (symbol_table *table, char const *name) {
+    if (2 * (table->count + 1) > table->capacity) { // grow and rehash
+        free (table->slots);
+        table->capacity = table->capacity ? 2 * table->capacity : 256;
+        table->slots = (size_t *) checked_malloc (table->capacity * sizeof (size_t));
+        memset (table->slots, 0, table->capacity * sizeof (size_t));
+        size_t id;
+        for (id = 0; id < table->count; id++) {
+            size_t i = table->symbols[id].hash & (table->capacity - 1);
+            while (table->slots[i])
+                i = (i + 1) & (table->capacity - 1);
+            table->slots[i] = id + 1;
+        }
+    }
+
+    size_t hash = hash_name (name);
+    size_t i = hash & (table->capacity - 1);
+    while (table->slots[i]) {
+        symbol *s = &table->symbols[table->slots[i] - 1];
+        if (s->hash == hash && !strcmp (s->name, name))
+            return table->slots[i] - 1;
+        i = (i + 1) & (table->capacity - 1);
+    }
+
+    if ((table->count + 1) * sizeof (symbol) > table->max_size) {
+        if (!table->max_size)
+            table->max_size = 64 * sizeof (symbol);
+        table->symbols = checked_grow_alloc (table->symbols, &table->max_size);
+    }
+    symbol *s = &table->symbols[table->count];
+    s->name = name;
+    s->hash = hash;
+    s->writer = NULL;
+    s->readers = NULL;
+    s->reader_count = 0;
+    s->max_reader_count = 0;
+    table->slots[i] = ++table->count;
+    return table->count - 1;
+}
+
+// Adds the edges node needs to its predecessors in script order, and records
+// its accesses in table.  A reader depends on the last writer of the file; a
+// writer depends on the readers since then, or if there were none on the last
+// writer.  Edges implied through those nodes are left out.
+void add_dependencies (symbol_table *table, graph_node *node) {
+    char **w;
+    for (w = node->inputs; *w; w++) {
+        size_t id = intern (table, *w); // may move table->symbols
+        symbol *s = &table->symbols[id];
+        if (s->reader_count && s->readers[s->reader_count - 1] == node)
+            continue; // named twice
+        if (s->writer && s->writer != node)
+            add_edge (s->writer, node);
+        if (s->reader_count == s->max_reader_count) {
+            size_t max_size = s->max_reader_count * sizeof (graph_node *);
+            if (!max_size)
+                max_size = WORDMIN * sizeof (graph_node *);
+            s->readers = checked_grow_alloc (s->readers, &max_size);
+            s->max_reader_count = max_size / sizeof (graph_node *);
+        }
+        s->readers[s->reader_count++] = node;
+    }
+
+    for (w = node->outputs; *w; w++) {
+        size_t id = intern (table, *w); // may move table->symbols
+        symbol *s = &table->symbols[id];
+        if (s->writer == node)
+            continue;
+        int ordered = 0;
+        size_t i;
+        for (i = 0; i < s->reader_count; i++)
+            if (s->readers[i] != node) {
+                add_edge (s->readers[i], node);
+                ordered = 1;
+            }
+        if (!ordered && s->writer) // Avoid interleaving output files
+            add_edge (s->writer, node);
+        s->writer = node;
+        s->reader_count = 0;
+    }
+}
+
+// Adds the edges between the nodes of node_list, in one pass over their words
+void add_all_dependencies (graph_nodes *node_list) {
+    symbol_table symbols = { NULL, 0, 0, NULL, 0 };
+    for (; node_list && node_list->node; node_list = node_list->next)
+        add_dependencies (&symbols, node_list->node);
+    free_symbols (&symbols);
+}
+
+void free_symbols (symbol_table *table) {
+    size_t id;
+    for (id = 0; id < table->count; id++)
+        free (table->symbols[id].readers);
+    free (table->symbols);
+    free (table->slots);
+}
+
+// Adds an edge from src to dst unless it was the last one added from src,
+// or src has already completed
+void add_edge (graph_node *src, graph_node *dst) {
+    if (src->last_dst == dst || src->done)
+        return;
+    src->last_dst = dst;
+    if (DEBUG) printf ("Adding edge from %i to %i\n", src->seq_no, dst->seq_no);
+    if (!src->out_edges) {
+        src->max_edge_count = WORDMIN;
+        src->out_edges = (graph_node **) checked_malloc (sizeof (graph_node *) * src->max_edge_count);
+    }
+    src->out_edges[src->edge_count] = dst;
+    src->edge_count++;
+    if (src->edge_count == src->max_edge_count) {
+        size_t max_size = src->max_edge_count * sizeof (graph_node *);
+        src->out_edges = checked_grow_alloc (src->out_edges, &max_size);
+        src->max_edge_count = max_size / (sizeof (graph_node *));
+    }
+    src->out_edges[src->edge_count] = 0;
+    dst->in_edges++;
+}
+
+// The mapped cache image, whose nodes are not freed
+static char *cache_start, *cache_end;
+
+static int
+cached (void const *p)
+{
+    return cache_start <= (char const *) p && (char const *) p < cache_end;
+}
+
+// Written to when a child exits, to wake a poll for jobserver tokens
+static int sigchld_pipe[2] = { -1, -1 };
+
+static void
+note_sigchld (int sig)
+{
+    int saved_errno = errno;
+    if (write (sigchld_pipe[1], "", 1)) {}
+    errno = saved_errno;
+}
+
+// Exits a node's child as its command ended: killed by the same signal, so
+// that the parent sees the wait status sequential execution gives, or with
+// its exit status.  The command has already dumped any core.
+static void
+exit_as (int status)
+{
+    if (WIFSIGNALED (status)) {
+        struct rlimit no_core = { 0, 0 };
+        sigset_t set;
+        setrlimit (RLIMIT_CORE, &no_core);
+        signal (WTERMSIG (status), SIG_DFL);
+        sigemptyset (&set);
+        sigaddset (&set, WTERMSIG (status));
+        sigprocmask (SIG_UNBLOCK, &set, NULL);
+        raise (WTERMSIG (status));
+        _exit (128 + WTERMSIG (status));
+    }
+    _exit (WEXITSTATUS (status));
+}
+
+// Runs every node of node_list once its prerequisites have completed, with
+// at most max_jobs running at once.  If jobserver_fd is not -1, each node
+// beyond the first also needs a token from make's jobserver.  Each
+// completion is reaped with wait_own, and the dependents it releases are
+// queued right away.  Ready nodes start highest rank first; with a profile,
+// each node's wall time is recorded in prof.  With a state, ready nodes that
+// are up to date complete without running, and the fingerprints of those
+// that succeed are recorded.  When tracing, each node is a span on the track
+// of the job slot it used, or of its pid in a nested graph.  With buffered
+// output, each node writes its stdout and stderr to memory files, which are
+// copied out in script order as soon as every earlier node's have been.
+// Returns the command with the highest seq_no, as sequential execution would.
+command_t execute_parallel (graph_nodes *node_list, int time_travel, int max_jobs, int jobserver_fd, profile *prof, run_state *state) {
+    scheduler sched;
+    start_scheduler (&sched, time_travel, max_jobs, jobserver_fd, prof, state, 0);
+
+    // Queue the nodes with no incoming edges; the list is not needed after
+    while (node_list) {
+        graph_nodes *next = node_list->next;
+        if (node_list->node)
+            schedule_node (&sched, node_list->node);
+        if (!cached (node_list))
+            free (node_list);
+        node_list = next;
+    }
+    return finish_scheduler (&sched);
+}
+
+// Starts a run of nodes with the limits of execute_parallel.  Online, nodes
+// are scheduled while others run, and are kept until the end so that later
+// ones can find them.
+void start_scheduler (scheduler *sched, int time_travel, int max_jobs, int jobserver_fd, profile *prof, run_state *state, int online) {
+    memset (sched, 0, sizeof *sched);
+    sched->time_travel = time_travel;
+    sched->max_jobs = max_jobs;
+    sched->jobserver_fd = jobserver_fd;
+    sched->prof = prof;
+    sched->state = state;
+    sched->online = online;
+    size_t id;
+    for (id = 0; prof && id < prof->commands.count; id++)
+        if (prof->memory[id] >= 0) {
+            sched->memory_known += prof->memory[id];
+            sched->memory_known_count++;
+        }
+
+    if (jobserver_fd >= 0 || online) {
+        struct sigaction sa;
+        if (pipe (sigchld_pipe) == -1)
+            error (1, errno, "execute_parallel: pipe");
+        fcntl (sigchld_pipe[0], F_SETFL, O_NONBLOCK);
+        fcntl (sigchld_pipe[1], F_SETFL, O_NONBLOCK);
+        fcntl (sigchld_pipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl (sigchld_pipe[1], F_SETFD, FD_CLOEXEC);
+        memset (&sa, 0, sizeof sa);
+        sa.sa_handler = note_sigchld;
+        sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+        sigaction (SIGCHLD, &sa, NULL);
+    }
+
+    if (travel_buffered) {
+        struct stat out, err;
+        sched->shared = fstat (STDOUT_FILENO, &out) == 0 && fstat (STDERR_FILENO, &err) == 0
+            && out.st_dev == err.st_dev && out.st_ino == err.st_ino;
+
+        // Nodes that finish early hold their buffers open
+        struct rlimit limit;
+        if (getrlimit (RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit (RLIMIT_NOFILE, &limit);
+        }
+    }
+}
+
+// Adds node, the next in script order, to the run, and queues it if none
+// of its prerequisites are left
+void schedule_node (scheduler *sched, graph_node *node) {
+    if (travel_buffered) {
+        if ((sched->count + 1) * sizeof (output_buffer) > sched->max_buffer_size) {
+            if (!sched->max_buffer_size)
+                sched->max_buffer_size = 64 * sizeof (output_buffer);
+            sched->buffers = checked_grow_alloc (sched->buffers, &sched->max_buffer_size);
+        }
+        output_buffer *buffer = &sched->buffers[sched->count];
+        buffer->out = buffer->err = -1;
+        buffer->done = 0;
+    }
+    sched->count++;
+    if (node->in_edges == 0)
+        push_ready (&sched->ready, node);
+}
+
+// Returns the kB node is expected to use at its peak: what its command
+// used last time, or else the mean of the known peaks
+static long
+expected_memory (scheduler *sched, graph_node *node)
+{
+    profile *prof = sched->prof;
+    if (prof && prof->memory[node->profile_id] >= 0)
+        return prof->memory[node->profile_id];
+    return sched->memory_known_count ? sched->memory_known / sched->memory_known_count : UNKNOWN_MEMORY;
+}
+
+// Records that node's command used memory kB at its peak
+static void
+learn_memory (scheduler *sched, graph_node *node, long memory)
+{
+    long *known = &sched->prof->memory[node->profile_id];
+    if (*known >= 0) {
+        sched->memory_known -= *known;
+        sched->memory_known_count--;
+    }
+    *known = memory;
+    sched->memory_known += memory;
+    sched->memory_known_count++;
+}
+
+// Returns the kB of memory available for new processes without swapping,
+// or LONG_MAX if the kernel does not say
+static long
+available_memory (void)
+{
+    long available = LONG_MAX;
+    char line[256];
+    FILE *f = fopen ("/proc/meminfo", "re");
+    if (!f)
+        return available;
+    while (fgets (line, sizeof line, f))
+        if (sscanf (line, "MemAvailable: %ld kB", &available) == 1)
+            break;
+    fclose (f);
+    return available;
+}
+
+// Returns 1 if tasks have lately stalled on memory for more than
+// PRESSURE_LIMIT percent of the time, per the kernel's pressure stall
+// information
+static int
+memory_pressure (void)
+{
+    double some = 0;
+    FILE *f = fopen ("/proc/pressure/memory", "re");
+    if (!f)
+        return 0;
+    if (fscanf (f, "some avg10=%lf", &some) != 1)
+        some = 0;
+    fclose (f);
+    return some > PRESSURE_LIMIT;
+}
+
+// Launches ready nodes while there are free slots.  The first running node
+// uses our own implicit job token.
+void launch_ready (scheduler *sched) {
+    graph_node *node;
+    pid_t child;
+    graph_node *held[HOLD_MAX]; // ready nodes that do not fit in memory now
+    size_t held_count = 0;
+    long available = -1; // kB, read when first needed
+    int pressure = 0;
+    sched->token_wait = 0;
+    while (sched->ready.count) {
+        node = sched->ready.nodes[0];
+        if (sched->state && up_to_date (sched->state, node)) {
+            if (DEBUG) printf ("Skipping command %i\n", node->seq_no);
+            pop_ready (&sched->ready);
+            node->command->status = 0;
+            if (sched->buffers)
+                sched->buffers[node->seq_no - 1].done = 1;
+            finish_node (sched, node);
+            if (sched->buffers)
+                flush_buffers (sched->buffers, sched->count, &sched->flushed);
+            continue;
+        }
+        if (sched->running.count >= (size_t) sched->max_jobs)
+            break;
+
+        // With a memory budget, a node that would not fit next to the
+        // running ones waits, and others behind it may start first.  The
+        // first running node always starts.  A nested graph counts as its
+        // subshell's node.
+        if (travel_memory_budget && !travel_nested) {
+            node->memory = expected_memory (sched, node);
+            if (sched->running.count && available < 0) {
+                available = available_memory ();
+                pressure = memory_pressure ();
+            }
+            if (sched->running.count
+                && (sched->memory_used + node->memory > travel_memory_budget
+                    || node->memory > available
+                    || (pressure && node->memory > CHEAP_MEMORY))) {
+                if (held_count == HOLD_MAX)
+                    break;
+                held[held_count++] = pop_ready (&sched->ready);
+                continue;
+            }
+        }
+        // Without descriptors for its buffer, a node waits for earlier
+        // buffers to be flushed and closed.  If its output is next anyway,
+        // or nothing runs that could free one, it writes unbuffered.
+        output_buffer *buffer = sched->buffers ? &sched->buffers[node->seq_no - 1] : NULL;
+        if (buffer && buffer->out < 0 && open_buffer (buffer, sched->shared) != 0) {
+            if (sched->running.count && (size_t) node->seq_no - 1 != sched->flushed)
+                break;
+            buffer = NULL;
+        }
+        if (sched->running.count && sched->jobserver_fd >= 0 && !jobserver_acquire ()) {
+            sched->token_wait = 1;
+            break;
+        }
+        if (sched->running.count)
+            sched->tokens += sched->jobserver_fd >= 0;
+        pop_ready (&sched->ready);
+        sched->memory_used += node->memory;
+        if (available >= 0)
+            available = available > node->memory ? available - node->memory : 0;
+        if (DEBUG) printf ("Executing command %i\n", node->seq_no);
+        if (sched->prof)
+            clock_gettime (CLOCK_MONOTONIC, &node->started);
+        if (tracing && !travel_nested) {
+            size_t slot = 0;
+            while (slot < sched->busy_size && sched->busy[slot])
+                slot++;
+            if (slot == sched->busy_size) {
+                sched->busy = checked_realloc (sched->busy, ++sched->busy_size);
+                char name[32];
+                snprintf (name, sizeof name, "slot %zu", sched->busy_size);
+                trace_name_track (sched->busy_size, name);
+            }
+            sched->busy[slot] = 1;
+            node->track = slot + 1;
+        }
+        if (tracing)
+            node->forked_at = trace_now ();
+        child = fork ();
+        if (child == 0) { // child
+            if (sigchld_pipe[0] >= 0) {
+                signal (SIGCHLD, SIG_DFL);
+                close (sigchld_pipe[0]);
+                close (sigchld_pipe[1]);
+                sigchld_pipe[0] = sigchld_pipe[1] = -1;
+            }
+            if (buffer && (dup2 (buffer->out, STDOUT_FILENO) < 0 || dup2 (buffer->err, STDERR_FILENO) < 0))
+                error (1, errno, "execute_parallel: dup2");
+            if (tracing) {
+                trace_track = travel_nested ? getpid () : node->track;
+                trace_span ("fork", trace_track, node->forked_at, trace_now (), 0, 0, NULL, NULL);
+            }
+            execute_command (node->command, sched->time_travel);
+            exit_as (node->command->status);
+        } else if (child > 0) { // parent
+            if (travel_nested)
+                node->track = child;
+            pid_map_put (&sched->running, child, node);
+        } else
+            error (1, 0, "execute_parallel: failed to create child process!");
+    }
+
+    // Held nodes stay ready, as queued as they were
+    while (held_count) {
+        node = held[--held_count];
+        long long ready_at = node->ready_at;
+        push_ready (&sched->ready, node);
+        node->ready_at = ready_at;
+    }
+}
+
+// Waits for whichever child finishes first, and reaps it and any others that
+// are already done.  When ready nodes are only waiting for a token, also
+// wakes up when the jobserver has one, and if fd is not -1, when it is
+// readable.  Returns 1 if fd is readable.
+int wait_scheduler (scheduler *sched, int fd) {
+    int flags = 0, readable = 0;
+    int token_wait = sched->token_wait;
+    if (token_wait || fd >= 0) {
+        struct pollfd fds[3] = {
+            { sigchld_pipe[0], POLLIN, 0 },
+            { token_wait ? sched->jobserver_fd : -1, POLLIN, 0 },
+            { fd, POLLIN, 0 }
+        };
+        char buf[64];
+        if (poll (fds, 3, -1) == -1 && errno != EINTR)
+            error (1, errno, "execute_parallel: poll");
+        while (read (sigchld_pipe[0], buf, sizeof buf) > 0)
+            continue;
+        readable = fd >= 0 && fds[2].revents;
+        flags = WNOHANG;
+    }
+    if (!sched->running.count)
+        return readable;
+
+    pid_t child;
+    int status;
+    struct rusage usage;
+    while ((child = wait_own (sched->running.pids, sched->running.capacity, &status, flags, &usage)) != 0) {
+        if (child < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ECHILD)
+                break;
+            error (1, errno, "execute_parallel: wait4");
+        }
+        flags = WNOHANG; // then reap any others that are already done
+        graph_node *node = pid_map_take (&sched->running, child);
+        if (!node)
+            continue;
+        if (DEBUG) printf ("%i:%i completed with status %i\n", node->seq_no, child, status);
+        node->command->status = status;
+        sched->memory_used -= node->memory;
+        if (sched->prof) {
+            learn_memory (sched, node, usage.ru_maxrss);
+            struct timespec now;
+            clock_gettime (CLOCK_MONOTONIC, &now);
+            sched->prof->seconds[node->profile_id] = (now.tv_sec - node->started.tv_sec)
+                + (now.tv_nsec - node->started.tv_nsec) / 1e9;
+        }
+        if (tracing) {
+            char extra[64];
+            char *text = command_text (node->command);
+            snprintf (extra, sizeof extra, "\"queued_us\":%lld", node->forked_at - node->ready_at);
+            trace_span (text, node->track, node->forked_at, trace_now (), child, status, &usage, extra);
+            free (text);
+            if (!travel_nested)
+                sched->busy[node->track - 1] = 0;
+        }
+        if (sched->state)
+            sched->state->fingerprints[node->state_id] = status == 0 && node->outputs[0] ? fingerprint (sched->state, node) : 0;
+        if (sched->tokens && sched->tokens >= sched->running.count) {
+            jobserver_release ();
+            sched->tokens--;
+        }
+        if (sched->buffers)
+            sched->buffers[node->seq_no - 1].done = 1;
+        finish_node (sched, node);
+        if (sched->buffers)
+            flush_buffers (sched->buffers, sched->count, &sched->flushed);
+    }
+    return readable;
+}
+
+// Runs the nodes of the run until all have completed, and frees it.
+// Returns the command with the highest seq_no.
+command_t finish_scheduler (scheduler *sched) {
+    while (sched->ready.count || sched->running.count) {
+        launch_ready (sched);
+        wait_scheduler (sched, -1);
+    }
+
+    if (sigchld_pipe[0] >= 0) {
+        signal (SIGCHLD, SIG_DFL);
+        close (sigchld_pipe[0]);
+        close (sigchld_pipe[1]);
+        sigchld_pipe[0] = sigchld_pipe[1] = -1;
+    }
+    free (sched->running.pids);
+    free (sched->running.nodes);
+    free (sched->ready.nodes);
+    free (sched->busy);
+    free (sched->buffers);
+    return sched->last_command;
+}
+
+// Returns the next byte of an online script for make_command_stream.  While
+// none has arrived, ready nodes are launched and finished ones reaped.
+int online_byte (void *arg) {
+    online_script *script = arg;
+    while (script->pos == script->len) {
+        launch_ready (script->sched);
+        if (!wait_scheduler (script->sched, script->fd))
+            continue;
+        ssize_t n = read (script->fd, script->buf, sizeof script->buf);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (n <= 0)
+            return EOF;
+        script->pos = 0;
+        script->len = n;
+    }
+    return (unsigned char) script->buf[script->pos++];
+}
+
+// Notes that node has completed, releases its dependents, and frees it
+// unless the run is online
+void finish_node (scheduler *sched, graph_node *node) {
+    node->done = 1;
+    if (node->seq_no > sched->last_seq_no) {
+        sched->last_seq_no = node->seq_no;
+        sched->last_command = node->command;
+    }
+    decrement (node, &sched->ready);
+    if (sched->online || cached (node))
+        return;
+    free (node->inputs);
+    free (node->outputs);
+    free (node->out_edges);
+    free (node);
+}
+
+// Removes node's outgoing edges, queueing dependents that become ready
+void decrement (graph_node *node, ready_queue *ready) {
+    graph_node **out = node->out_edges;
+    while (out && *out) {
+        if (DEBUG) printf ("\nDecrementing from %i; ", (*out)->seq_no);
+        if (--(*out)->in_edges == 0)
+            push_ready (ready, *out);
+        out++;
+    }
+}
+
+// Returns 1 if a should start before b
+static int
+runs_before (graph_node *a, graph_node *b)
+{
+    return a->rank != b->rank ? a->rank > b->rank : a->seq_no < b->seq_no;
+}
+
+void push_ready (ready_queue *ready, graph_node *node) {
+    if (tracing)
+        node->ready_at = trace_now ();
+    if ((ready->count + 1) * sizeof (graph_node *) > ready->max_size) {
+        if (!ready->max_size)
+            ready->max_size = 32 * sizeof (graph_node *);
+        ready->nodes = checked_grow_alloc (ready->nodes, &ready->max_size);
+    }
+    size_t i = ready->count++;
+    while (i && runs_before (node, ready->nodes[(i - 1) / 2])) {
+        ready->nodes[i] = ready->nodes[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    ready->nodes[i] = node;
+}
+
+graph_node *pop_ready (ready_queue *ready) {
+    if (!ready->count)
+        return NULL;
+    graph_node *node = ready->nodes[0];
+    graph_node *last = ready->nodes[--ready->count];
+    size_t i = 0, child;
+    while ((child = 2 * i + 1) < ready->count) {
+        if (child + 1 < ready->count && runs_before (ready->nodes[child + 1], ready->nodes[child]))
+            child++;
+        if (!runs_before (ready->nodes[child], last))
+            break;
+        ready->nodes[i] = ready->nodes[child];
+        i = child;
+    }
+    ready->nodes[i] = last;
+    return node;
+}
+
+void pid_map_put (pid_map *map, pid_t pid, graph_node *node) {
+    if (2 * (map->count + 1) > map->capacity) { // grow and rehash
+        pid_map old = *map;
+        map->capacity = old.capacity ? 2 * old.capacity : 64;
+        map->pids = (pid_t *) checked_malloc (map->capacity * sizeof (pid_t));
+        map->nodes = (graph_node **) checked_malloc (map->capacity * sizeof (graph_node *));
+        memset (map->pids, 0, map->capacity * sizeof (pid_t));
+        map->count = 0;
+        size_t i;
+        for (i = 0; i < old.capacity; i++)
+            if (old.pids[i])
+                pid_map_put (map, old.pids[i], old.nodes[i]);
+        free (old.pids);
+        free (old.nodes);
+    }
+    size_t i = (size_t) pid & (map->capacity - 1);
+    while (map->pids[i])
+        i = (i + 1) & (map->capacity - 1);
+    map->pids[i] = pid;
+    map->nodes[i] = node;
+    map->count++;
+}
+
+// Removes pid from map and returns its node, or NULL if it is not there
+graph_node *pid_map_take (pid_map *map, pid_t pid) {
+    if (!map->capacity)
+        return NULL;
+    size_t mask = map->capacity - 1;
+    size_t i = (size_t) pid & mask;
+    while (map->pids[i] && map->pids[i] != pid)
+        i = (i + 1) & mask;
+    if (!map->pids[i])
+        return NULL;
+    graph_node *node = map->nodes[i];
+    map->pids[i] = 0;
+    map->count--;
+
+    // Shift later entries of the probe run back over the hole
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!map->pids[j])
+            break;
+        size_t home = (size_t) map->pids[j] & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            map->pids[i] = map->pids[j];
+            map->nodes[i] = map->nodes[j];
+            map->pids[j] = 0;
+            i = j;
+        }
+    }
+    return node;
+}
+
+// Reaps whichever of the count children in pids exits first, as wait4
+// (-1) would, but leaves any other child of the process to whoever started
+// it.  Slots that are not positive are skipped.  The first exited child is
+// only looked at; if it is not ours, ours are checked one by one, every
+// 10 ms while none has exited.  Returns the pid reaped, 0 if none has
+// exited and flags has WNOHANG, or -1 with errno set.
+pid_t wait_own (pid_t const *pids, size_t count, int *status, int flags, struct rusage *usage) {
+    for (;;) {
+        siginfo_t info;
+        info.si_pid = 0;
+        if (waitid (P_ALL, 0, &info, WEXITED | WNOWAIT | (flags & WNOHANG)) == -1)
+            return -1;
+        if (!info.si_pid)
+            return 0;
+        size_t i;
+        for (i = 0; i < count && pids[i] != info.si_pid; i++)
+            continue;
+        if (i < count)
+            return wait4 (info.si_pid, status, 0, usage);
+
+        pid_t child;
+        for (i = 0; i < count; i++)
+            if (pids[i] > 0 && (child = wait4 (pids[i], status, WNOHANG, usage)) != 0)
+                return child;
+        if (flags & WNOHANG)
+            return 0;
+        struct timespec pause = { 0, 10000000 };
+        nanosleep (&pause, NULL);
+    }
+}
+
+// Opens memory files for buffer, one for stdout and stderr if shared.
+// Returns 0, or -1 with errno set and buffer left unopened.
+int open_buffer (output_buffer *buffer, int shared) {
+    buffer->out = memfd_create ("stdout", MFD_CLOEXEC);
+    buffer->err = shared || buffer->out < 0 ? buffer->out : memfd_create ("stderr", MFD_CLOEXEC);
+    if (buffer->err >= 0)
+        return 0;
+    int saved = errno;
+    if (buffer->out >= 0)
+        close (buffer->out);
+    buffer->out = buffer->err = -1;
+    errno = saved;
+    return -1;
+}
+
+// Copies out the buffers of the done nodes that follow the flushed ones in
+// script order, and closes them
+void flush_buffers (output_buffer *buffers, size_t count, size_t *flushed) {
+    for (; *flushed < count && buffers[*flushed].done; ++*flushed) {
+        output_buffer *buffer = &buffers[*flushed];
+        if (buffer->out < 0)
+            continue; // skipped as up to date
+        copy_buffer (buffer->out, STDOUT_FILENO);
+        if (buffer->err != buffer->out) {
+            copy_buffer (buffer->err, STDERR_FILENO);
+            close (buffer->err);
+        }
+        close (buffer->out);
+    }
+}
+
+// Copies the whole of file fd to to, in the kernel when it can
+void copy_buffer (int fd, int to) {
+    struct stat st;
+    if (fstat (fd, &st) != 0)
+        error (1, errno, "execute_parallel: fstat");
+    off_t offset = 0;
+    while (offset < st.st_size) {
+        ssize_t n = sendfile (to, fd, &offset, st.st_size - offset);
+        if (n > 0)
+            continue;
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EINVAL || errno == ENOSYS)) { // to cannot take it
+            char buf[65536];
+            while ((n = pread (fd, buf, sizeof buf, offset)) > 0) {
+                ssize_t done = 0;
+                while (done < n) {
+                    ssize_t w = write (to, buf + done, n - done);
+                    if (w < 0 && errno == EINTR)
+                        continue;
+                    if (w <= 0)
+                        return; // as a node writing there would have failed
+                    done += w;
+                }
+                offset += n;
+            }
+        }
+        return;
+    }
+}
+
+graph_nodes *append_command (graph_nodes *last_node, command_t command, int *command_number) {
+    // Split up top level sequence commands
+    while (command->type == SEQUENCE_COMMAND) {
+        if (command->type == SEQUENCE_COMMAND) {
+            last_node = append_command (last_node, command->u.command[0], command_number);
+            last_node = append_command (last_node, command->u.command[1], command_number);
+            return last_node;
+        }
+    }
+    // Parse and add to last_node
+    if (DEBUG) {
+        printf ("# %d\n", *command_number);
+        print_command (command);
+    }
+    
+    graph_node *n = parse_io (command, (*command_number)++);
+    if (last_node->node) {
+        last_node->next = (graph_nodes *) checked_malloc (sizeof (graph_nodes));
+        last_node->next->prev = last_node;
+        last_node = last_node->next;
+    }
+    last_node->node = n;
+    last_node->next = NULL;
+    return last_node;
+}
+
+// Reads the "SECONDS<tab>COMMAND" lines of file into prof, or
+// "SECONDS<tab>KB<tab>COMMAND" where the command's peak memory is known.  A
+// missing file is an empty profile.
+void load_profile (profile *prof, char const *file) {
+    FILE *f = fopen (file, "r");
+    if (!f) {
+        if (errno == ENOENT)
+            return;
+        error (1, errno, "%s: cannot open", file);
+    }
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t n;
+    int line_number = 0;
+    while ((n = getline (&line, &line_size, f)) > 0) {
+        line_number++;
+        if (line[n - 1] == '\n')
+            line[--n] = 0;
+        char *end;
+        double seconds = strtod (line, &end);
+        if (end == line || *end != '\t' || !end[1] || seconds < 0)
+            error (1, 0, "%s:%d: bad profile entry", file, line_number);
+        char *text = end + 1;
+        long memory = strtol (text, &end, 10);
+        if (end == text || *end != '\t' || !end[1] || memory < 0)
+            memory = -1; // commands hold no tabs
+        else
+            text = end + 1;
+        size_t len = n - (text - line);
+        char *key = (char *) checked_malloc (len + 1);
+        memcpy (key, text, len + 1);
+        size_t id = profile_id (prof, key); // may move prof->seconds
+        prof->seconds[id] = seconds;
+        prof->memory[id] = memory;
+    }
+    free (line);
+    fclose (f);
+}
+
+// Returns the index of key in prof, adding it with an unknown time if it is
+// new.  Takes ownership of key.
+size_t profile_id (profile *prof, char *key) {
+    size_t id = intern (&prof->commands, key);
+    if (prof->commands.symbols[id].name != key) {
+        free (key);
+        return id;
+    }
+    if ((id + 1) * sizeof (double) > prof->max_size) {
+        if (!prof->max_size)
+            prof->max_size = 64 * sizeof (double);
+        prof->seconds = checked_grow_alloc (prof->seconds, &prof->max_size);
+    }
+    if ((id + 1) * sizeof (long) > prof->max_memory_size) {
+        if (!prof->max_memory_size)
+            prof->max_memory_size = 64 * sizeof (long);
+        prof->memory = checked_grow_alloc (prof->memory, &prof->max_memory_size);
+    }
+    prof->seconds[id] = -1;
+    prof->memory[id] = -1;
+    return id;
+}
+
+// Replaces file with the known times and peaks in prof
+void save_profile (profile *prof, char const *file) {
+    size_t len = strlen (file);
+    char *temp = (char *) checked_malloc (len + sizeof ".new");
+    memcpy (temp, file, len);
+    memcpy (temp + len, ".new", sizeof ".new");
+    FILE *f = fopen (temp, "w");
+    if (!f)
+        error (1, errno, "%s: cannot create", temp);
+    size_t id;
+    for (id = 0; id < prof->commands.count; id++)
+        if (prof->seconds[id] >= 0 && prof->memory[id] >= 0)
+            fprintf (f, "%.6f\t%ld\t%s\n", prof->seconds[id], prof->memory[id], prof->commands.symbols[id].name);
+        else if (prof->seconds[id] >= 0)
+            fprintf (f, "%.6f\t%s\n", prof->seconds[id], prof->commands.symbols[id].name);
+    if (fclose (f) != 0 || rename (temp, file) != 0)
+        error (1, errno, "%s: cannot write", file);
+    free (temp);
+}
+
+void free_profile (profile *prof) {
+    size_t id;
+    for (id = 0; id < prof->commands.count; id++)
+        free ((char *) prof->commands.symbols[id].name);
+    free_symbols (&prof->commands);
+    free (prof->seconds);
+    free (prof->memory);
+}
+
+// Sets each node's rank to its expected time plus the largest rank among its
+// dependents, walking back from last_node.  Nodes without a profiled time
+// are expected to take the average of those with one.
+void rank_nodes (graph_nodes *last_node, profile *prof) {
+    double total = 0, guess = 1e-3;
+    size_t known = 0;
+    graph_nodes *n;
+    for (n = last_node; n && n->node; n = n->prev)
+        if (prof->seconds[n->node->profile_id] >= 0) {
+            total += prof->seconds[n->node->profile_id];
+            known++;
+        }
+    if (known)
+        guess = total / known;
+
+    for (n = last_node; n && n->node; n = n->prev) {
+        graph_node *node = n->node;
+        double seconds = prof->seconds[node->profile_id];
+        double downstream = 0;
+        graph_node **out;
+        for (out = node->out_edges; out && *out; out++)
+            if ((*out)->rank > downstream)
+                downstream = (*out)->rank;
+        node->rank = (seconds >= 0 ? seconds : guess) + downstream;
+    }
+}
+
+// Reads the "FINGERPRINT<tab>COMMAND" lines of file into state.  A missing
+// file is an empty state.
+void load_state (run_state *state, char const *file) {
+    FILE *f = fopen (file, "r");
+    if (!f) {
+        if (errno == ENOENT)
+            return;
+        error (1, errno, "%s: cannot open", file);
+    }
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t n;
+    int line_number = 0;
+    while ((n = getline (&line, &line_size, f)) > 0) {
+        line_number++;
+        if (line[n - 1] == '\n')
+            line[--n] = 0;
+        char *end;
+        unsigned long long print = strtoull (line, &end, 16);
+        if (end == line || *end != '\t' || !end[1])
+            error (1, 0, "%s:%d: bad state entry", file, line_number);
+        size_t len = n - (end + 1 - line);
+        char *key = (char *) checked_malloc (len + 1);
+        memcpy (key, end + 1, len + 1);
+        size_t id = state_id (state, key); // may move state->fingerprints
+        state->fingerprints[id] = print;
+    }
+    free (line);
+    fclose (f);
+}
+
+// Returns the index of key in state, adding it with no fingerprint if it is
+// new.  Takes ownership of key.
+size_t state_id (run_state *state, char *key) {
+    size_t id = intern (&state->commands, key);
+    if (state->commands.symbols[id].name != key) {
+        free (key);
+        return id;
+    }
+    if ((id + 1) * sizeof (unsigned long long) > state->max_size) {
+        if (!state->max_size)
+            state->max_size = 64 * sizeof (unsigned long long);
+        state->fingerprints = checked_grow_alloc (state->fingerprints, &state->max_size);
+    }
+    state->fingerprints[id] = 0;
+    return id;
+}
+
+// Replaces file with the known fingerprints in state
+void save_state (run_state *state, char const *file) {
+    size_t len = strlen (file);
+    char *temp = (char *) checked_malloc (len + sizeof ".new");
+    memcpy (temp, file, len);
+    memcpy (temp + len, ".new", sizeof ".new");
+    FILE *f = fopen (temp, "w");
+    if (!f)
+        error (1, errno, "%s: cannot create", temp);
+    size_t id;
+    for (id = 0; id < state->commands.count; id++)
+        if (state->fingerprints[id])
+            fprintf (f, "%016llx\t%s\n", state->fingerprints[id], state->commands.symbols[id].name);
+    if (fclose (f) != 0 || rename (temp, file) != 0)
+        error (1, errno, "%s: cannot write", file);
+    free (temp);
+}
+
+void free_state (run_state *state) {
+    size_t id;
+    for (id = 0; id < state->commands.count; id++)
+        free ((char *) state->commands.symbols[id].name);
+    free_symbols (&state->commands);
+    free (state->fingerprints);
+}
+
+static unsigned long long
+hash_bytes (unsigned long long h, void const *bytes, size_t size)
+{
+    unsigned char const *b = bytes;
+    while (size--)
+        h = (h ^ *b++) * 1099511628211ull; // FNV-1a
+    return h;
+}
+
+// Returns a hash of node's command text and the size and modification time
+// of each file it reads or writes; never 0
+unsigned long long fingerprint (run_state *state, graph_node *node) {
+    char const *key = state->commands.symbols[node->state_id].name;
+    unsigned long long h = hash_bytes (14695981039346656037ull, key, strlen (key) + 1);
+    char **lists[2] = { node->inputs, node->outputs };
+    int i;
+    for (i = 0; i < 2; i++) {
+        char **w;
+        for (w = lists[i]; *w; w++) {
+            struct stat st;
+            h = hash_bytes (h, *w, strlen (*w) + 1);
+            if (stat (*w, &st) == 0) {
+                h = hash_bytes (h, &st.st_size, sizeof st.st_size);
+                h = hash_bytes (h, &st.st_mtim, sizeof st.st_mtim);
+            } else
+                h = hash_bytes (h, "", 1); // does not exist
+        }
+    }
+    return h ? h : 1;
+}
+
+// Returns 1 if node writes files and its fingerprint is the one recorded
+// after its last successful run.  Nodes that write no files are always run,
+// for the sake of their other effects.
+int up_to_date (run_state *state, graph_node *node) {
+    if (node->dirty || !node->outputs[0])
+        return 0;
+    unsigned long long print = state->fingerprints[node->state_id];
+    if (print && print == fingerprint (state, node))
+        return 1;
+    node->dirty = 1;
+    return 0;
+}
+
+// Runs the commands of sequence, the body of a subshell inside a node, as a
+// graph of their own like the script's top level, and sets its status to
+// that of the last one.  Nested graphs share the script's job slots, or
+// set them up when run straight from the library.  execute_parallel frees
+// the nodes and the list as they complete.
+void execute_time_travel (command_t sequence) {
+    int command_number = 1;
+    int nested = travel_nested;
+    travel_nested = 1;
+    if (!travel_max_jobs)
+        setup_travel_jobs (0);
+    graph_nodes *node_list = (graph_nodes *) checked_malloc (sizeof (graph_nodes));
+    node_list->prev = NULL;
+    node_list->next = NULL;
+    node_list->node = NULL;
+    append_command (node_list, sequence, &command_number);
+    add_all_dependencies (node_list);
+    command_t last_command = execute_parallel (node_list, 1, travel_max_jobs, travel_jobserver_fd, NULL, NULL);
+    sequence->status = last_command ? last_command->status : 0;
+    travel_nested = nested;
+}
+
+// Frees the nodes of node_list that were not loaded from a cache
+void free_nodes (graph_nodes *node_list) {
+    while (node_list) {
+        graph_nodes *next = node_list->next;
+        if (node_list->node && !cached (node_list->node)) {
+            free (node_list->node->inputs);
+            free (node_list->node->outputs);
+            free (node_list->node->out_edges);
+            free (node_list->node);
+        }
+        if (!cached (node_list))
+            free (node_list);
+        node_list = next;
+    }
+}
+
+#define CACHE_MAGIC "ttcache1"
+
+// Where cache images are meant to be mapped: far from the heap, the stack
+// and the places mmap picks by itself
+#define CACHE_BASE ((uintptr_t) (sizeof (void *) == 8 ? 0x100000000000ull : 0x40000000ull))
+
+// Returns a hash of the layout of the cached structures, and of the
+// signatures and options that decide a graph's commands and edges
+static unsigned long long
+cache_key (void)
+{
+    size_t sizes[] = { sizeof (struct command), sizeof (graph_node), sizeof (graph_nodes), sizeof (cache_header), travel_optimizing };
+    unsigned long long h = signature_digest ();
+    return hash_bytes (h, sizes, sizeof sizes);
+}
+
+// Sets *hash to a hash of the bytes of file and returns 1, or returns 0 if
+// file is not a regular file
+int hash_script (char const *file, unsigned long long *hash) {
+    int fd = open (file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        error (1, errno, "%s: cannot open", file);
+    struct stat st;
+    if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode)) {
+        close (fd);
+        return 0;
+    }
+    unsigned long long h = 14695981039346656037ull;
+    char buf[65536];
+    ssize_t n;
+    while ((n = read (fd, buf, sizeof buf)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            error (1, errno, "%s: read error", file);
+        }
+        h = hash_bytes (h, buf, n);
+    }
+    close (fd);
+    *hash = h;
+    return 1;
+}
+
+// Maps the cache in file and returns its nodes, ready to run without
+// parsing.  Returns NULL if file does not exist or was not made from a
+// script with script_hash by this build of timetrash.  The mapping is
+// private, so running the graph changes only our copy.  If it cannot be
+// mapped at the address the image assumes, its pointers are relocated.
+graph_nodes *load_cache (char const *file, unsigned long long script_hash) {
+    int fd = open (file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT)
+            return NULL;
+        error (1, errno, "%s: cannot open", file);
+    }
+    cache_header header;
+    struct stat st;
+    if (read (fd, &header, sizeof header) != sizeof header
+        || memcmp (header.magic, CACHE_MAGIC, sizeof header.magic)
+        || header.script_hash != script_hash || header.key != cache_key ()
+        || fstat (fd, &st) != 0 || header.size > header.relocs
+        || (size_t) st.st_size != header.relocs + header.reloc_count * sizeof (size_t)) {
+        close (fd);
+        return NULL;
+    }
+
+    char *image = mmap ((void *) header.base, st.st_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, 0);
+    if (image == MAP_FAILED)
+        image = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (image == MAP_FAILED)
+        error (1, errno, "%s: cannot map", file);
+    close (fd);
+    if ((uintptr_t) image != header.base) {
+        uintptr_t delta = (uintptr_t) image - header.base;
+        size_t *relocs = (size_t *) (image + header.relocs);
+        size_t i;
+        for (i = 0; i < header.reloc_count; i++) {
+            if (relocs[i] % sizeof (uintptr_t) || relocs[i] > header.size - sizeof (uintptr_t))
+                error (1, 0, "%s: corrupt cache", file);
+            *(uintptr_t *) (image + relocs[i]) += delta;
+        }
+    }
+    cache_start = image;
+    cache_end = image + header.size;
+    return ((cache_header *) image)->list;
+}
+
+// Replaces file with an image of the nodes of node_list, which must be in
+// script order, and their commands
+void save_cache (graph_nodes *node_list, char const *file, unsigned long long script_hash) {
+    cache_image image = { NULL, 0, 0, NULL, 0, 0 };
+    size_t count = 0, i;
+    graph_nodes *n;
+    for (n = node_list; n && n->node; n = n->next)
+        count++;
+
+    // The nodes and list entries are arrays, indexed by seq_no - 1
+    size_t header = cache_alloc (&image, sizeof (cache_header));
+    size_t nodes = cache_alloc (&image, count * sizeof (graph_node));
+    size_t list = cache_alloc (&image, (count ? count : 1) * sizeof (graph_nodes));
+    for (n = node_list, i = 0; i < count; n = n->next, i++) {
+        graph_node *node = n->node;
+        size_t at = nodes + i * sizeof (graph_node);
+        size_t entry = list + i * sizeof (graph_nodes);
+        cache_pointer (&image, at + offsetof (graph_node, command), cache_command (&image, node->command));
+        cache_pointer (&image, at + offsetof (graph_node, inputs), cache_words (&image, node->inputs));
+        cache_pointer (&image, at + offsetof (graph_node, outputs), cache_words (&image, node->outputs));
+        if (node->edge_count) {
+            size_t edges = cache_alloc (&image, (node->edge_count + 1) * sizeof (graph_node *));
+            int e;
+            for (e = 0; e < node->edge_count; e++)
+                cache_pointer (&image, edges + e * sizeof (graph_node *),
+                               nodes + (node->out_edges[e]->seq_no - 1) * sizeof (graph_node));
+            cache_pointer (&image, at + offsetof (graph_node, out_edges), edges);
+        }
+        graph_node *copy = (graph_node *) (image.data + at);
+        copy->seq_no = node->seq_no;
+        copy->edge_count = node->edge_count;
+        copy->max_edge_count = node->edge_count + 1;
+        copy->in_edges = node->in_edges;
+
+        cache_pointer (&image, entry + offsetof (graph_nodes, node), at);
+        if (i + 1 < count)
+            cache_pointer (&image, entry + offsetof (graph_nodes, next), entry + sizeof (graph_nodes));
+        if (i)
+            cache_pointer (&image, entry + offsetof (graph_nodes, prev), entry - sizeof (graph_nodes));
+    }
+    cache_pointer (&image, header + offsetof (cache_header, list), list);
+
+    cache_header *h = (cache_header *) (image.data + header);
+    memcpy (h->magic, CACHE_MAGIC, sizeof h->magic);
+    h->script_hash = script_hash;
+    h->key = cache_key ();
+    h->base = CACHE_BASE;
+    h->size = image.size;
+    h->relocs = (image.size + sizeof (size_t) - 1) / sizeof (size_t) * sizeof (size_t);
+    h->reloc_count = image.reloc_count;
+
+    size_t len = strlen (file);
+    char *temp = (char *) checked_malloc (len + sizeof ".new");
+    memcpy (temp, file, len);
+    memcpy (temp + len, ".new", sizeof ".new");
+    FILE *f = fopen (temp, "w");
+    if (!f)
+        error (1, errno, "%s: cannot create", temp);
+    static char const padding[sizeof (size_t)];
+    fwrite (image.data, 1, image.size, f);
+    fwrite (padding, 1, h->relocs - image.size, f);
+    fwrite (image.relocs, sizeof (size_t), image.reloc_count, f);
+    if (ferror (f) || fclose (f) != 0 || rename (temp, file) != 0)
+        error (1, errno, "%s: cannot write", file);
+    free (temp);
+    free (image.data);
+    free (image.relocs);
+}
+
+// Returns the offset of size new zeroed bytes in image, aligned for any of
+// the cached structures
+size_t cache_alloc (cache_image *image, size_t size) {
+    size_t at = (image->size + sizeof (uintptr_t) - 1) / sizeof (uintptr_t) * sizeof (uintptr_t);
+    while (at + size > image->max_size) {
+        if (!image->max_size)
+            image->max_size = 4096;
+        image->data = checked_grow_alloc (image->data, &image->max_size);
+    }
+    memset (image->data + image->size, 0, at + size - image->size);
+    image->size = at + size;
+    return at;
+}
+
+// Points the pointer at offset slot of image to offset target, as it will
+// be once the image is mapped at CACHE_BASE
+void cache_pointer (cache_image *image, size_t slot, size_t target) {
+    uintptr_t p = CACHE_BASE + target;
+    memcpy (image->data + slot, &p, sizeof p);
+    if ((image->reloc_count + 1) * sizeof (size_t) > image->max_reloc_size) {
+        if (!image->max_reloc_size)
+            image->max_reloc_size = 256 * sizeof (size_t);
+        image->relocs = checked_grow_alloc (image->relocs, &image->max_reloc_size);
+    }
+    image->relocs[image->reloc_count++] = slot;
+}
+
+size_t cache_string (cache_image *image, char const *string) {
+    size_t len = strlen (string) + 1;
+    size_t at = cache_alloc (image, len);
+    memcpy (image->data + at, string, len);
+    return at;
+}
+
+// Returns the offset of a copy of the null-terminated array words
+size_t cache_words (cache_image *image, char **words) {
+    size_t count = 0, i;
+    while (words[count])
+        count++;
+    size_t at = cache_alloc (image, (count + 1) * sizeof (char *));
+    for (i = 0; i < count; i++)
+        cache_pointer (image, at + i * sizeof (char *), cache_string (image, words[i]));
+    return at;
+}
+
+// Returns the offset of a copy of command, which has not been run
+size_t cache_command (cache_image *image, command_t command) {
+    size_t at = cache_alloc (image, sizeof (struct command));
+    struct command *copy = (struct command *) (image->data + at);
+    copy->type = command->type;
+    copy->status = -1;
+    if (command->input)
+        cache_pointer (image, at + offsetof (struct command, input), cache_string (image, command->input));
+    if (command->output)
+        cache_pointer (image, at + offsetof (struct command, output), cache_string (image, command->output));
+    switch (command->type) {
+    case SIMPLE_COMMAND:
+        cache_pointer (image, at + offsetof (struct command, u.word), cache_words (image, command->u.word));
+        break;
+    case SUBSHELL_COMMAND:
+        cache_pointer (image, at + offsetof (struct command, u.subshell_command),
+                       cache_command (image, command->u.subshell_command));
+        break;
+    default:
+        cache_pointer (image, at + offsetof (struct command, u.command[0]), cache_command (image, command->u.command[0]));
+        cache_pointer (image, at + offsetof (struct command, u.command[1]), cache_command (image, command->u.command[1]));
+        break;
+    }
+    return at;
+}
@@ -0,0 +1,223 @@
+// UCLA CS 111 Lab 1 time travel: graphs of commands run in parallel
+
+// Include command.h before this file.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Limits and modes of time travel, shared by the graphs of nested sequences
+extern int travel_max_jobs;
+extern int travel_jobserver_fd; // -1 if there is no jobserver
+extern int travel_buffered; // emit each node's output in script order
+extern int travel_optimizing; // commands are rewritten by optimize_command
+extern long travel_memory_budget; // kB the running nodes may use; 0 for no limit
+
+typedef struct graph_node {
+    command_t command;
+    int seq_no;
+    char **inputs;
+    char **outputs;
+    struct graph_node **out_edges;
+    int max_edge_count;
+    int edge_count;
+    int in_edges;
+    double rank; // estimated seconds from its start to the end of the script
+    size_t profile_id; // index of its command text in the profile
+    size_t state_id; // index of its command text in the incremental state
+    int dirty; // known to need running
+    int done; // completed, so later nodes need not wait for it
+    long memory; // kB it was expected to use when it started
+    struct timespec started;
+    long long ready_at, forked_at; // trace times
+    int track; // trace track it runs on
+    struct graph_node *last_dst; // destination of the newest out edge
+} graph_node;
+
+typedef struct graph_nodes {
+    graph_node *node;
+    struct graph_nodes *next;
+    struct graph_nodes *prev;
+} graph_nodes;
+
+// TODO: split up disconnected graphs and run independently
+typedef struct graph_list {
+    graph_nodes *graph;
+    struct graph_list *next;
+} graph_list;
+
+// Heap of nodes whose prerequisites have all completed, highest rank first
+// and then in script order
+typedef struct ready_queue {
+    graph_node **nodes;
+    size_t count;
+    size_t max_size; // bytes allocated for nodes
+} ready_queue;
+
+// Where a node's output waits until every earlier node's has been emitted
+typedef struct output_buffer {
+    int out; // -1 if not opened
+    int err; // the same as out if stdout and stderr are the same file
+    int done;
+} output_buffer;
+
+// Open-addressed map from the pid of a running child to its node
+typedef struct pid_map {
+    pid_t *pids; // 0 marks an empty slot
+    graph_node **nodes;
+    size_t capacity; // power of 2
+    size_t count;
+} pid_map;
+
+// A file name, and the nodes that last accessed it in script order
+typedef struct symbol {
+    char const *name;
+    size_t hash;
+    graph_node *writer; // last node to write it
+    graph_node **readers; // nodes that read it since then
+    size_t reader_count;
+    size_t max_reader_count;
+} symbol;
+
+// Interns file names as indices into symbols
+typedef struct symbol_table {
+    symbol *symbols;
+    size_t count;
+    size_t max_size; // bytes allocated for symbols
+    size_t *slots; // symbol index + 1; 0 marks an empty slot
+    size_t capacity; // power of 2
+} symbol_table;
+
+// Words collected by extract_io, keeping those whose role matches
+typedef struct word_list {
+    char **words;
+    size_t count;
+    size_t max_size;
+    int role;
+} word_list;
+
+// Wall times of earlier runs, by command text
+typedef struct profile {
+    symbol_table commands; // owns the command texts
+    double *seconds; // by command index; negative if not known
+    size_t max_size; // bytes allocated for seconds
+    long *memory; // peak kB by command index; negative if not known
+    size_t max_memory_size; // bytes allocated for memory
+} profile;
+
+// Fingerprints of commands and their files after their last successful run
+typedef struct run_state {
+    symbol_table commands; // owns the command texts
+    unsigned long long *fingerprints; // by command index; 0 if not known
+    size_t max_size; // bytes allocated for fingerprints
+} run_state;
+
+// A script cache file starts with this, followed by the image and then
+// the offsets of the pointer slots in the image
+typedef struct cache_header {
+    char magic[8];
+    unsigned long long script_hash; // of the bytes of the script
+    unsigned long long key; // of the layout and signatures that built it
+    uintptr_t base; // address the image's pointers assume it is mapped at
+    size_t size; // bytes in the image, this header included
+    size_t relocs; // offset of the pointer slot offsets
+    size_t reloc_count;
+    graph_nodes *list; // the script's nodes
+} cache_header;
+
+// A cache image being built, with the pointer slots written so far
+typedef struct cache_image {
+    char *data;
+    size_t size;
+    size_t max_size; // bytes allocated for data
+    size_t *relocs;
+    size_t reloc_count;
+    size_t max_reloc_size; // bytes allocated for relocs
+} cache_image;
+
+// A run of nodes by execute_parallel: those ready to start, those running,
+// and the limits they start within
+typedef struct scheduler {
+    int time_travel;
+    int max_jobs;
+    int jobserver_fd;
+    profile *prof;
+    run_state *state;
+    int online; // nodes are scheduled while others run, and kept until the end
+    command_t last_command; // of the highest seq_no completed
+    int last_seq_no;
+    ready_queue ready;
+    pid_map running;
+    size_t tokens; // jobserver tokens held; one fewer than running nodes
+    int token_wait; // a ready node is waiting for a jobserver token
+    long memory_used; // kB the running nodes are expected to use
+    double memory_known; // sum of the known peaks in prof, in kB
+    size_t memory_known_count;
+    unsigned char *busy; // which trace slots are in use
+    size_t busy_size;
+    output_buffer *buffers; // by seq_no - 1, if output is buffered
+    size_t max_buffer_size; // bytes allocated for buffers
+    size_t count, flushed; // nodes, and those whose output is out
+    int shared; // stdout and stderr are the same file
+} scheduler;
+
+// A script read while its commands run, in chunks of whatever has arrived
+typedef struct online_script {
+    int fd;
+    scheduler *sched;
+    size_t pos, len; // of the unread bytes in buf
+    char buf[4096];
+} online_script;
+
+// functions
+void setup_travel_jobs (int max_jobs);
+void analyze_graph (graph_nodes *node_list, profile *prof, int max_cores, FILE *dot);
+graph_node *parse_io (command_t command, int command_number);
+char **extract_io (command_t command, char io);
+void add_word (void *list, char *word, int role);
+size_t intern (symbol_table *table, char const *name);
+void add_dependencies (symbol_table *table, graph_node *node);
+void add_all_dependencies (graph_nodes *node_list);
+void free_symbols (symbol_table *table);
+void add_edge (graph_node *src, graph_node *dst);
+void load_profile (profile *prof, char const *file);
+size_t profile_id (profile *prof, char *key);
+void save_profile (profile *prof, char const *file);
+void free_profile (profile *prof);
+void rank_nodes (graph_nodes *last_node, profile *prof);
+void load_state (run_state *state, char const *file);
+size_t state_id (run_state *state, char *key);
+void save_state (run_state *state, char const *file);
+void free_state (run_state *state);
+unsigned long long fingerprint (run_state *state, graph_node *node);
+int up_to_date (run_state *state, graph_node *node);
+command_t execute_parallel (graph_nodes *node_list, int time_travel, int max_jobs, int jobserver_fd, profile *prof, run_state *state);
+void start_scheduler (scheduler *sched, int time_travel, int max_jobs, int jobserver_fd, profile *prof, run_state *state, int online);
+void schedule_node (scheduler *sched, graph_node *node);
+void launch_ready (scheduler *sched);
+int wait_scheduler (scheduler *sched, int fd);
+command_t finish_scheduler (scheduler *sched);
+int online_byte (void *arg);
+void finish_node (scheduler *sched, graph_node *node);
+void decrement (graph_node *node, ready_queue *ready);
+void push_ready (ready_queue *ready, graph_node *node);
+graph_node *pop_ready (ready_queue *ready);
+void pid_map_put (pid_map *map, pid_t pid, graph_node *node);
+graph_node *pid_map_take (pid_map *map, pid_t pid);
+pid_t wait_own (pid_t const *pids, size_t count, int *status, int flags, struct rusage *usage);
+int open_buffer (output_buffer *buffer, int shared);
+void flush_buffers (output_buffer *buffers, size_t count, size_t *flushed);
+void copy_buffer (int fd, int to);
+graph_nodes *append_command (graph_nodes *last_node, command_t command, int *command_number);
+void free_nodes (graph_nodes *node_list);
+int hash_script (char const *file, unsigned long long *hash);
+graph_nodes *load_cache (char const *file, unsigned long long script_hash);
+void save_cache (graph_nodes *node_list, char const *file, unsigned long long script_hash);
+size_t cache_alloc (cache_image *image, size_t size);
+void cache_pointer (cache_image *image, size_t slot, size_t target);
+size_t cache_string (cache_image *image, char const *string);
+size_t cache_words (cache_image *image, char **words);
+size_t cache_command (cache_image *image, command_t command);
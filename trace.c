@@ -0,0 +1,153 @@
+// UCLA CS 111 Lab 1 execution traces in Chrome's trace event format
+
+#include "trace.h"
+#include "alloc.h"
+
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/* The file is a JSON array with one event per line.  Forked processes
+   share its descriptor, which is in append mode, and each event is a
+   single write, so events from concurrent processes do not interleave.  */
+
+int tracing;
+int trace_track = 1;
+
+static int trace_fd = -1;
+static pid_t trace_pid; // the process that started the trace
+
+// Append the text formatted from FORMAT to the trace in a single write
+static void
+trace_printf (char const *format, ...)
+{
+  char small[1024];
+  char *buf = small;
+  va_list args;
+  va_start (args, format);
+  int len = vsnprintf (small, sizeof small, format, args);
+  va_end (args);
+  if (len < 0)
+    return;
+  if ((size_t) len >= sizeof small)
+    {
+      buf = checked_malloc (len + 1);
+      va_start (args, format);
+      vsnprintf (buf, len + 1, format, args);
+      va_end (args);
+    }
+  char const *p = buf;
+  while (len > 0)
+    {
+      ssize_t n = write (trace_fd, p, len);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      p += n;
+      len -= n;
+    }
+  if (buf != small)
+    free (buf);
+}
+
+// Return NAME with the characters JSON strings cannot hold escaped
+static char *
+json_escape (char const *name)
+{
+  char *escaped = checked_malloc (6 * strlen (name) + 1);
+  char *q = escaped;
+  for (; *name; name++)
+    {
+      unsigned char c = *name;
+      if (c == '"' || c == '\\')
+        {
+          *q++ = '\\';
+          *q++ = c;
+        }
+      else if (c < ' ')
+        q += sprintf (q, "\\u%04x", c);
+      else
+        *q++ = c;
+    }
+  *q = 0;
+  return escaped;
+}
+
+void
+trace_open (char const *file)
+{
+  trace_fd = open (file, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                   0666);
+  if (trace_fd < 0)
+    error (1, errno, "%s: cannot create", file);
+  trace_pid = getpid ();
+  tracing = 1;
+  trace_printf ("[\n");
+}
+
+void
+trace_close (void)
+{
+  if (! tracing)
+    return;
+  trace_printf ("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"args\":{\"name\":\"timetrash\"}}\n]\n", (int) trace_pid);
+  close (trace_fd);
+  tracing = 0;
+}
+
+long long
+trace_now (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+void
+trace_name_track (int track, char const *name)
+{
+  char *escaped = json_escape (name);
+  trace_printf ("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}},\n",
+                (int) trace_pid, track, escaped);
+  free (escaped);
+}
+
+void
+trace_span (char const *name, int track, long long start, long long end,
+            pid_t pid, int status, struct rusage const *usage,
+            char const *extra)
+{
+  char args[512];
+  int len = 0;
+  if (pid > 0)
+    len += snprintf (args + len, sizeof args - len, "\"pid\":%d,\"status\":%d,",
+                     (int) pid, status);
+  if (usage)
+    len += snprintf (args + len, sizeof args - len,
+                     "\"user_ms\":%.3f,\"sys_ms\":%.3f,\"maxrss_kb\":%ld,"
+                     "\"minflt\":%ld,\"majflt\":%ld,",
+                     usage->ru_utime.tv_sec * 1e3 + usage->ru_utime.tv_usec / 1e3,
+                     usage->ru_stime.tv_sec * 1e3 + usage->ru_stime.tv_usec / 1e3,
+                     usage->ru_maxrss, usage->ru_minflt, usage->ru_majflt);
+  if (extra)
+    len += snprintf (args + len, sizeof args - len, "%s,", extra);
+  if (len)
+    args[len - 1] = 0; // drop the last comma
+
+  char *escaped = json_escape (name);
+  trace_printf ("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                "\"ts\":%lld,\"dur\":%lld,\"args\":{%s}},\n",
+                escaped, (int) trace_pid, track, start, end - start,
+                len ? args : "");
+  free (escaped);
+}
@@ -0,0 +1,32 @@
+// UCLA CS 111 Lab 1 execution traces in Chrome's trace event format
+
+#include <sys/types.h>
+
+struct rusage;
+
+/* Nonzero once trace_open has been called.  */
+extern int tracing;
+
+/* The track on which this process records the commands it runs.  */
+extern int trace_track;
+
+/* Start a trace in FILE.  Processes forked afterwards append their own
+   events to it.  */
+void trace_open (char const *file);
+
+/* Finish the trace.  Call only once every traced process is done.  */
+void trace_close (void);
+
+/* Return the current time in microseconds, on the trace's clock.  */
+long long trace_now (void);
+
+/* Label TRACK as NAME.  */
+void trace_name_track (int track, char const *name);
+
+/* Record that NAME ran on TRACK from START to END.  If PID is positive,
+   also record it, the wait status STATUS, and USAGE if it is not null.
+   EXTRA, if not null, holds more "key":value members for the event's
+   arguments.  */
+void trace_span (char const *name, int track, long long start, long long end,
+                 pid_t pid, int status, struct rusage const *usage,
+                 char const *extra);